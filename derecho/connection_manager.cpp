@@ -9,22 +9,22 @@ bool tcp_connections::add_connection(const node_id_t other_id,
                                      const ip_addr_t& other_ip) {
     if(other_id < my_id) {
         try {
-            sockets[other_id] = socket(other_ip, port);
+            sockets[other_id] = socket(other_ip, port_of(other_id));
         } catch(exception) {
             std::cerr << "WARNING: failed to node " << other_id << " at "
-                      << other_ip << ":" << port << std::endl;
+                      << other_ip << ":" << port_of(other_id) << std::endl;
             return false;
         }
 
         uint32_t remote_id = 0;
         if(!sockets[other_id].exchange(my_id, remote_id)) {
             std::cerr << "WARNING: failed to exchange rank with node "
-                      << other_id << " at " << other_ip << ":" << port
+                      << other_id << " at " << other_ip << ":" << port_of(other_id)
                       << std::endl;
             sockets.erase(other_id);
             return false;
         } else if(remote_id != other_id) {
-            std::cerr << "WARNING: node at " << other_ip << ":" << port
+            std::cerr << "WARNING: node at " << other_ip << ":" << port_of(other_id)
                       << " replied with wrong id (expected " << other_id
                       << " but got " << remote_id << ")" << std::endl;
 
@@ -62,7 +62,7 @@ bool tcp_connections::add_connection(const node_id_t other_id,
 }
 
 void tcp_connections::establish_node_connections(const std::map<node_id_t, ip_addr_t>& ip_addrs) {
-    conn_listener = std::make_unique<connection_listener>(port);
+    conn_listener = std::make_unique<connection_listener>(port_of(my_id));
 
     for(auto it = ip_addrs.begin(); it != ip_addrs.end(); it++) {
         //Check that there isn't already a connection to this ID,
@@ -78,8 +78,9 @@ void tcp_connections::establish_node_connections(const std::map<node_id_t, ip_ad
 
 tcp_connections::tcp_connections(node_id_t _my_id,
                                  const std::map<node_id_t, ip_addr_t>& ip_addrs,
-                                 uint32_t _port)
-        : my_id(_my_id), port(_port) {
+                                 uint32_t _port,
+                                 bool _port_per_node)
+        : my_id(_my_id), port(_port), port_per_node(_port_per_node) {
     establish_node_connections(ip_addrs);
 }
 
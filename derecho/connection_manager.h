@@ -15,16 +15,23 @@ class tcp_connections {
 
     node_id_t my_id;
     const uint32_t port;
+    /** If true, each node listens on port + its node ID rather than on port,
+     * so that several nodes can share a host. */
+    const bool port_per_node;
     std::unique_ptr<connection_listener> conn_listener;
     std::map<node_id_t, socket> sockets;
     bool add_connection(const node_id_t other_id,
                         const ip_addr_t& other_ip);
     void establish_node_connections(const std::map<node_id_t, ip_addr_t>& ip_addrs);
+    uint32_t port_of(const node_id_t node_id) const {
+        return port_per_node ? port + node_id : port;
+    }
 
 public:
     tcp_connections(node_id_t _my_id,
                     const std::map<node_id_t, ip_addr_t>& ip_addrs,
-                    uint32_t _port);
+                    uint32_t _port,
+                    bool _port_per_node = false);
     void destroy();
     bool write(node_id_t node_id, char const* buffer, size_t size);
     bool write_all(char const* buffer, size_t size);
@@ -95,7 +95,7 @@ std::string DerechoSST::to_string() const {
 
         s << "}, global_min_ready= { ";
         for(uint n = 0; n < global_min_ready.size(); n++) {
-            s << global_min_ready[row] << " ";
+            s << (global_min_ready[row][n] ? "T" : "F") << " ";
         }
         s << "}" << std::endl;
     }
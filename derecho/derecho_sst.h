@@ -20,6 +20,7 @@ using cstring = char[MAX_STRING_LEN];
 
 using sst::SSTField;
 using sst::SSTFieldVector;
+using sst::SSTFieldBlockVector;
 /**
  * The GMS and derecho_group will share the same SST for efficiency. This class
  * defines all the fields in this SST.
@@ -38,20 +39,20 @@ public:
      * This variable is the highest sequence number that has been received
      * in-order by this node; if a node updates seq_num, it has received all
      * messages up to seq_num in the global round-robin order. */
-    SSTFieldVector<long long int> seq_num;
+    SSTFieldBlockVector<long long int> seq_num;
     /** This represents the highest sequence number that has been received
      * by every node, as observed by this node. If a node updates stable_num,
      * then it believes that all messages up to stable_num in the global
      * round-robin order have been received by every node. */
-    SSTFieldVector<long long int> stable_num;
+    SSTFieldBlockVector<long long int> stable_num;
     /** This represents the highest sequence number that has been delivered
      * at this node. Messages are only delievered once stable, so it must be
      * at least stable_num. */
-    SSTFieldVector<long long int> delivered_num;
+    SSTFieldBlockVector<long long int> delivered_num;
     /** This represents the highest sequence number that has been persisted
      * to disk at this node, if persistence is enabled. Messages are only
      * persisted to disk once delivered to the application. */
-    SSTFieldVector<long long int> persisted_num;
+    SSTFieldBlockVector<long long int> persisted_num;
 
     // Group management service members, related only to handling view changes
     /** View ID associated with this SST. VIDs monotonically increase as views change. */
@@ -87,18 +88,20 @@ public:
     /** Local count of number of received messages by sender.  For each
      * sender k, nReceived[k] is the number received (a.k.a. "locally stable").
      */
-    SSTFieldVector<long long int> num_received;
+    SSTFieldBlockVector<long long int> num_received;
     /** Set after calling rdmc::wedged(), reports that this member is wedged.
      * Must be after num_received!*/
     SSTField<bool> wedged;
     /** Array of how many messages to accept from each sender in the current view change */
-    SSTFieldVector<int> global_min;
+    SSTFieldBlockVector<int> global_min;
     /** Array indicating whether each shard leader (indexed by subgroup number)
      * has published a global_min for the current view change*/
-    SSTFieldVector<bool> global_min_ready;
-    /** for SST multicast */
-    SSTFieldVector<sst::Message> slots;
-    SSTFieldVector<long long int> num_received_sst;
+    SSTFieldBlockVector<bool> global_min_ready;
+    /** for SST multicast: each subgroup's ring of messages sent by this
+     * node, and for each subgroup, the number of bytes appended to it */
+    SSTFieldVector<char> ring;
+    SSTFieldBlockVector<uint64_t> ring_tail;
+    SSTFieldBlockVector<long long int> num_received_sst;
 
     /** to check for failures - used by the thread running check_failures_loop in derecho_group **/
     SSTField<bool> heartbeat;
@@ -107,26 +110,36 @@ public:
      * (0, false, etc.). Initializing the MulticastGroup fields is left to MulticastGroup.
      * @param parameters The SST parameters, which will be forwarded to the
      * standard SST constructor.
+     * @param num_subgroups The number of subgroups in the view.
+     * @param num_received_sizes For each subgroup, the number of entries it
+     * uses in num_received, global_min and num_received_sst.
+     * @param ring_size The size of each subgroup's SST multicast ring, in bytes.
+     *
+     * The fields with one or more entries per subgroup have one block per
+     * subgroup, so with the RowLayout::CACHE_LINE_BLOCKS layout all of a
+     * subgroup's entries share its own cache lines.
      */
-    DerechoSST(const sst::SSTParams& parameters, const uint32_t num_subgroups, const uint32_t num_received_size, uint32_t window_size)
+    DerechoSST(const sst::SSTParams& parameters, const uint32_t num_subgroups,
+               const std::vector<uint32_t>& num_received_sizes, uint32_t ring_size)
             : sst::SST<DerechoSST>(this, parameters),
-              seq_num(num_subgroups),
-              stable_num(num_subgroups),
-              delivered_num(num_subgroups),
-              persisted_num(num_subgroups),
+              seq_num(std::vector<uint32_t>(num_subgroups, 1)),
+              stable_num(std::vector<uint32_t>(num_subgroups, 1)),
+              delivered_num(std::vector<uint32_t>(num_subgroups, 1)),
+              persisted_num(std::vector<uint32_t>(num_subgroups, 1)),
               suspected(parameters.members.size()),
               changes(100 + parameters.members.size()),
               joiner_ips(100 + parameters.members.size()),
-              num_received(num_received_size),
-              global_min(num_received_size),
-              global_min_ready(num_subgroups),
-              slots(window_size * num_subgroups),
-              num_received_sst(num_received_size) {
+              num_received(num_received_sizes),
+              global_min(num_received_sizes),
+              global_min_ready(std::vector<uint32_t>(num_subgroups, 1)),
+              ring(ring_size * num_subgroups),
+              ring_tail(std::vector<uint32_t>(num_subgroups, 1)),
+              num_received_sst(num_received_sizes) {
         SSTInit(seq_num, stable_num, delivered_num,
                 persisted_num, vid, suspected, changes, joiner_ips,
                 num_changes, num_committed, num_acked, num_installed,
                 num_received, wedged, global_min, global_min_ready,
-                slots, num_received_sst, heartbeat);
+                ring, ring_tail, num_received_sst, heartbeat);
         //Once superclass constructor has finished, table entries can be initialized
         for(int row = 0; row < get_num_rows(); ++row) {
             vid[row] = 0;
@@ -224,6 +237,24 @@ void set(volatile Elem* array, volatile Elem* value, const size_t length) {
     }
     std::atomic_signal_fence(std::memory_order_acq_rel);
 }
+
+/**
+ * Thread-safe setter for DerechoSST members that are arrays, reading the
+ * values from ordinary memory such as an sst::row_snapshot.
+ * @param array A pointer to the first element of an array that should be set
+ * to {@code value}, obtained by calling SSTFieldVector::operator[]
+ * @param value A pointer to the first element of an array to read values from
+ * @param length The number of array elements to copy
+ */
+template <typename Elem>
+void set(volatile Elem* array, const Elem* value, const size_t length) {
+    static thread_local std::mutex set_mutex;
+    {
+        std::lock_guard<std::mutex> lock(set_mutex);
+        memcpy(const_cast<Elem*>(array), value, length * sizeof(Elem));
+    }
+    std::atomic_signal_fence(std::memory_order_acq_rel);
+}
 /**
  * Thread-safe setter for DerechoSST members that are arrays; takes a lock
  * before running memcpy, and then ensures there is an atomic_signal_fence.
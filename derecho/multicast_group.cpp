@@ -1,9 +1,14 @@
 #include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iterator>
 #include <limits>
 #include <thread>
 
+#include <sys/mman.h>
+
 #include "multicast_group.h"
 #include "rdmc/util.h"
 
@@ -23,6 +28,12 @@ size_t index_of(T container, U elem) {
     return container.size();
 }
 
+static uint64_t steady_time_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
 /**
  *
  * @param _members A list of node IDs of members in this group
@@ -68,12 +79,21 @@ MulticastGroup::MulticastGroup(
           max_msg_size(compute_max_msg_size(derecho_params.max_payload_size, derecho_params.block_size)),
           type(derecho_params.type),
           window_size(derecho_params.window_size),
+          sst_message_batching(derecho_params.sst_message_batching),
+          sst_max_msg_size(compute_sst_max_msg_size(derecho_params)),
+          sst_ack_batch_size(derecho_params.sst_ack_batch_size),
+          sst_ack_timeout_us(derecho_params.sst_ack_timeout_us),
+          num_sender_threads(std::max(derecho_params.num_sender_threads, 1u)),
+          message_buffer_huge_pages(derecho_params.message_buffer_huge_pages),
+          buffer_class_sizes(compute_buffer_class_sizes(max_msg_size)),
+          sst_send_threshold(derecho_params.sst_send_threshold),
+          rdmc_send_aggregation_size(std::min(derecho_params.rdmc_send_aggregation_size, max_msg_size)),
           callbacks(callbacks),
           total_num_subgroups(total_num_subgroups),
           subgroup_to_shard_and_rank(subgroup_to_shard_and_rank),
           subgroup_to_senders_and_sender_rank(subgroup_to_senders_and_sender_rank),
           subgroup_to_num_received_offset(subgroup_to_num_received_offset),
-          received_intervals(sst->num_received.size(), {-1, -1}),
+          received_intervals(sst->num_received.size(), ReceivedIndexWindow(window_size + 1)),
           subgroup_to_membership(subgroup_to_membership),
           subgroup_to_mode(subgroup_to_mode),
           rdmc_group_num_offset(0),
@@ -81,11 +101,21 @@ MulticastGroup::MulticastGroup(
           next_sends(total_num_subgroups),
           pending_sends(total_num_subgroups),
           current_sends(total_num_subgroups),
+          current_receives(total_num_subgroups),
+          locally_stable_rdmc_messages(total_num_subgroups),
+          locally_stable_sst_messages(total_num_subgroups),
+          non_persistent_messages(total_num_subgroups),
+          non_persistent_sst_messages(total_num_subgroups),
           next_message_to_deliver(total_num_subgroups),
           sender_timeout(derecho_params.timeout_ms),
           sst(sst),
           sst_multicast_group_ptrs(total_num_subgroups),
-          last_transfer_medium(total_num_subgroups) {
+          sst_ring_readers(total_num_subgroups),
+          sst_ack_states(total_num_subgroups),
+          subgroup_descriptors(total_num_subgroups),
+          last_transfer_medium(total_num_subgroups),
+          sst_send_thresholds(total_num_subgroups),
+          async_sends(total_num_subgroups) {
     assert(window_size >= 1);
 
     if(!derecho_params.filename.empty()) {
@@ -96,12 +126,13 @@ MulticastGroup::MulticastGroup(
     for(uint i = 0; i < num_members; ++i) {
         node_id_to_sst_index[members[i]] = i;
     }
+    initialize_subgroup_descriptors();
+    initialize_message_windows();
+    initialize_sender_threads();
 
-    for(const auto p : subgroup_to_shard_and_rank) {
-        auto num_shard_members = subgroup_to_membership.at(p.first).size();
-        while(free_message_buffers[p.first].size() < window_size * num_shard_members) {
-            free_message_buffers[p.first].emplace_back(max_msg_size);
-        }
+    initialize_message_buffers();
+    for(subgroup_id_t subgroup_num = 0; subgroup_num < total_num_subgroups; ++subgroup_num) {
+        set_sst_send_threshold(subgroup_num, sst_send_threshold);
     }
 
     initialize_sst_row();
@@ -118,8 +149,11 @@ MulticastGroup::MulticastGroup(
         // if groups are created successfully, rdmc_sst_groups_created will be set to true
         rdmc_sst_groups_created = create_rdmc_sst_groups();
     }
+    if(rdmc_sst_groups_created && derecho_params.calibrate_sst_send_threshold) {
+        calibrate_sst_send_thresholds();
+    }
     register_predicates();
-    sender_thread = std::thread(&MulticastGroup::send_loop, this);
+    start_sender_threads();
     timeout_thread = std::thread(&MulticastGroup::check_failures_loop, this);
 }
 
@@ -142,12 +176,21 @@ MulticastGroup::MulticastGroup(
           max_msg_size(old_group.max_msg_size),
           type(old_group.type),
           window_size(old_group.window_size),
+          sst_message_batching(old_group.sst_message_batching),
+          sst_max_msg_size(old_group.sst_max_msg_size),
+          sst_ack_batch_size(old_group.sst_ack_batch_size),
+          sst_ack_timeout_us(old_group.sst_ack_timeout_us),
+          num_sender_threads(old_group.num_sender_threads),
+          message_buffer_huge_pages(old_group.message_buffer_huge_pages),
+          buffer_class_sizes(old_group.buffer_class_sizes),
+          sst_send_threshold(old_group.sst_send_threshold),
+          rdmc_send_aggregation_size(old_group.rdmc_send_aggregation_size),
           callbacks(old_group.callbacks),
           total_num_subgroups(total_num_subgroups),
           subgroup_to_shard_and_rank(subgroup_to_shard_and_rank),
           subgroup_to_senders_and_sender_rank(subgroup_to_senders_and_sender_rank),
           subgroup_to_num_received_offset(subgroup_to_num_received_offset),
-          received_intervals(sst->num_received.size(), {-1, -1}),
+          received_intervals(sst->num_received.size(), ReceivedIndexWindow(window_size + 1)),
           subgroup_to_membership(subgroup_to_membership),
           subgroup_to_mode(subgroup_to_mode),
           rpc_callback(old_group.rpc_callback),
@@ -156,11 +199,21 @@ MulticastGroup::MulticastGroup(
           next_sends(total_num_subgroups),
           pending_sends(total_num_subgroups),
           current_sends(total_num_subgroups),
+          current_receives(total_num_subgroups),
+          locally_stable_rdmc_messages(total_num_subgroups),
+          locally_stable_sst_messages(total_num_subgroups),
+          non_persistent_messages(total_num_subgroups),
+          non_persistent_sst_messages(total_num_subgroups),
           next_message_to_deliver(total_num_subgroups),
           sender_timeout(old_group.sender_timeout),
           sst(sst),
           sst_multicast_group_ptrs(total_num_subgroups),
-          last_transfer_medium(total_num_subgroups) {
+          sst_ring_readers(total_num_subgroups),
+          sst_ack_states(total_num_subgroups),
+          subgroup_descriptors(total_num_subgroups),
+          last_transfer_medium(total_num_subgroups),
+          sst_send_thresholds(total_num_subgroups),
+          async_sends(total_num_subgroups) {
     // Make sure rdmc_group_num_offset didn't overflow.
     assert(old_group.rdmc_group_num_offset <= std::numeric_limits<uint16_t>::max() - old_group.num_members - num_members);
 
@@ -170,15 +223,35 @@ MulticastGroup::MulticastGroup(
     for(uint i = 0; i < num_members; ++i) {
         node_id_to_sst_index[members[i]] = i;
     }
+    initialize_subgroup_descriptors();
+    initialize_message_windows();
+    initialize_sender_threads();
+    // Subgroups keep the SST send thresholds they had, calibrated or set
+    for(subgroup_id_t subgroup_num = 0; subgroup_num < total_num_subgroups; ++subgroup_num) {
+        set_sst_send_threshold(subgroup_num, subgroup_num < old_group.sst_send_thresholds.size()
+                                                     ? old_group.sst_send_thresholds[subgroup_num].load()
+                                                     : sst_send_threshold);
+    }
 
     // Convience function that takes a msg from the old group and
     // produces one suitable for this group.
     auto convert_msg = [this](RDMCMessage& msg, subgroup_id_t subgroup_num) {
         msg.sender_id = members[member_index];
-        msg.index = future_message_indices[subgroup_num]++;
+        msg.index = future_message_indices[subgroup_num];
 
-        header* h = (header*)msg.message_buffer.buffer.get();
-        future_message_indices[subgroup_num] += h->pause_sending_turns;
+        header* h = (header*)msg.message_buffer.get();
+        h->index = msg.index;
+        if(h->aggregated) {
+            // the packed messages take the next indices in turn
+            sst::for_each_batched_message(msg.message_buffer.get() + sizeof(header), msg.size - sizeof(header),
+                                          [&](volatile char* packed_msg, uint32_t) {
+                                              header* packed_header = (header*)packed_msg;
+                                              packed_header->index = future_message_indices[subgroup_num]++;
+                                              future_message_indices[subgroup_num] += packed_header->pause_sending_turns;
+                                          });
+        } else {
+            future_message_indices[subgroup_num] += 1 + h->pause_sending_turns;
+        }
 
         return std::move(msg);
     };
@@ -195,55 +268,48 @@ MulticastGroup::MulticastGroup(
         return std::move(msg);
     };
 
-    for(const auto p : subgroup_to_shard_and_rank) {
-        auto num_shard_members = subgroup_to_membership.at(p.first).size();
-        while(free_message_buffers[p.first].size() < window_size * num_shard_members) {
-            free_message_buffers[p.first].emplace_back(max_msg_size);
-        }
-    }
-
-    // Reclaim RDMCMessageBuffers from the old group, and supplement them with
-    // additional if the group has grown.
+    // Reclaim the message buffers of the old group. Subgroups this node is
+    // still in keep their pools; the buffers of the others become spares.
     std::lock_guard<std::mutex> lock(old_group.msg_state_mtx);
-    for(const auto p : subgroup_to_shard_and_rank) {
-        const auto subgroup_num = p.first;
-        auto num_shard_members = subgroup_to_membership.at(p.first).size();
-        // for later: don't move extra message buffers
-        free_message_buffers[subgroup_num].swap(old_group.free_message_buffers[subgroup_num]);
-        while(free_message_buffers[subgroup_num].size() < old_group.window_size * num_shard_members) {
-            free_message_buffers[subgroup_num].emplace_back(max_msg_size);
+    spare_message_buffers.swap(old_group.spare_message_buffers);
+    for(auto& p : old_group.message_buffer_pools) {
+        if(subgroup_to_shard_and_rank.count(p.first)) {
+            message_buffer_pools[p.first] = std::move(p.second);
+        } else {
+            for(uint32_t size_class = 0; size_class < buffer_class_sizes.size(); ++size_class) {
+                auto& free_buffers = p.second.free_buffers[size_class];
+                std::move(free_buffers.begin(), free_buffers.end(),
+                          std::back_inserter(spare_message_buffers[size_class]));
+            }
         }
     }
-
-    for(auto& msg : old_group.current_receives) {
-        free_message_buffers[msg.first.first].push_back(std::move(msg.second.message_buffer));
+    old_group.message_buffer_pools.clear();
+    initialize_message_buffers();
+
+    for(subgroup_id_t subgroup_num = 0; subgroup_num < old_group.current_receives.size(); ++subgroup_num) {
+        old_group.current_receives[subgroup_num].for_each([&](long long int, RDMCMessage& msg) {
+            release_message_buffer(subgroup_num, std::move(msg.message_buffer));
+        });
+        old_group.current_receives[subgroup_num].clear();
     }
-    old_group.current_receives.clear();
 
     // Assume that any locally stable messages failed. If we were the sender
     // than re-attempt, otherwise discard. TODO: Presumably the ragged edge
     // cleanup will want the chance to deliver some of these.
-    for(auto& p : old_group.locally_stable_rdmc_messages) {
-        if(p.second.size() == 0) {
-            continue;
-        }
-
-        for(auto& q : p.second) {
-            if(q.second.sender_id == members[member_index]) {
-                pending_sends[p.first].push(convert_msg(q.second, p.first));
+    for(subgroup_id_t subgroup_num = 0; subgroup_num < old_group.locally_stable_rdmc_messages.size(); ++subgroup_num) {
+        old_group.locally_stable_rdmc_messages[subgroup_num].for_each([&](long long int, RDMCMessage& msg) {
+            if(msg.sender_id == members[member_index]) {
+                pending_sends[subgroup_num].push(convert_msg(msg, subgroup_num));
             } else {
-                free_message_buffers[p.first].push_back(std::move(q.second.message_buffer));
+                release_message_buffer(subgroup_num, std::move(msg.message_buffer));
             }
-        }
+        });
+        old_group.locally_stable_rdmc_messages[subgroup_num].clear();
     }
-    old_group.locally_stable_rdmc_messages.clear();
 
-    for(auto& p : old_group.locally_stable_sst_messages) {
-        if(p.second.size() == 0) {
-            continue;
-        }
+    for(auto& messages : old_group.locally_stable_sst_messages) {
+        messages.clear();
     }
-    old_group.locally_stable_sst_messages.clear();
 
     // Any messages that were being sent should be re-attempted.
     for(auto p : subgroup_to_shard_and_rank) {
@@ -263,16 +329,18 @@ MulticastGroup::MulticastGroup(
             next_sends[subgroup_num] = convert_msg(*old_group.next_sends[subgroup_num], subgroup_num);
         }
 
-        for(auto& entry : old_group.non_persistent_messages[subgroup_num]) {
-            non_persistent_messages[subgroup_num].emplace(entry.first,
-                                                          convert_msg(entry.second, subgroup_num));
+        if(old_group.non_persistent_messages.size() > subgroup_num) {
+            old_group.non_persistent_messages[subgroup_num].for_each([&](long long int seq_num, RDMCMessage& msg) {
+                non_persistent_messages[subgroup_num].insert(seq_num, convert_msg(msg, subgroup_num));
+            });
+            old_group.non_persistent_messages[subgroup_num].clear();
         }
-        old_group.non_persistent_messages.clear();
-        for(auto& entry : old_group.non_persistent_sst_messages[subgroup_num]) {
-            non_persistent_sst_messages[subgroup_num].emplace(entry.first,
-                                                              convert_sst_msg(entry.second, subgroup_num));
+        if(old_group.non_persistent_sst_messages.size() > subgroup_num) {
+            old_group.non_persistent_sst_messages[subgroup_num].for_each([&](long long int seq_num, SSTMessage& msg) {
+                non_persistent_sst_messages[subgroup_num].insert(seq_num, convert_sst_msg(msg, subgroup_num));
+            });
+            old_group.non_persistent_sst_messages[subgroup_num].clear();
         }
-        old_group.non_persistent_sst_messages.clear();
     }
 
     // If the old group was using persistence, we should transfer its state to the new group
@@ -296,10 +364,262 @@ MulticastGroup::MulticastGroup(
         rdmc_sst_groups_created = create_rdmc_sst_groups();
     }
     register_predicates();
-    sender_thread = std::thread(&MulticastGroup::send_loop, this);
+    start_sender_threads();
     timeout_thread = std::thread(&MulticastGroup::check_failures_loop, this);
 }
 
+void MulticastGroup::initialize_subgroup_descriptors() {
+    for(const auto& p : subgroup_to_membership) {
+        const subgroup_id_t subgroup_num = p.first;
+        const std::vector<node_id_t>& shard_members = p.second;
+        const std::vector<int>& shard_senders = subgroup_to_senders_and_sender_rank.at(subgroup_num).first;
+        SubgroupDescriptor& desc = subgroup_descriptors[subgroup_num];
+        desc.mode = subgroup_to_mode.at(subgroup_num);
+        desc.num_received_offset = subgroup_to_num_received_offset.at(subgroup_num);
+        desc.my_sender_rank = subgroup_to_senders_and_sender_rank.at(subgroup_num).second;
+        for(uint shard_rank = 0; shard_rank < shard_members.size(); ++shard_rank) {
+            const uint32_t sst_index = node_id_to_sst_index.at(shard_members[shard_rank]);
+            desc.shard_sst_indices.push_back(sst_index);
+            if(shard_senders[shard_rank]) {
+                desc.sender_ids.push_back(shard_members[shard_rank]);
+                desc.sender_sst_indices.push_back(sst_index);
+            }
+        }
+        desc.shard_row_offsets = sst::row_offsets(desc.shard_sst_indices, sst->seq_num.rowLen);
+    }
+}
+
+/**
+ * A sender cannot start a message until every member has delivered its
+ * message window_size turns earlier, so the messages waiting in a subgroup
+ * span at most window_size + 1 turns of each sender.
+ */
+void MulticastGroup::initialize_message_windows() {
+    for(const auto& p : subgroup_to_shard_and_rank) {
+        const subgroup_id_t subgroup_num = p.first;
+        const uint32_t num_shard_senders = subgroup_descriptors[subgroup_num].num_senders();
+        const size_t capacity = (window_size + 1) * num_shard_senders;
+        current_receives[subgroup_num] = SequenceWindow<RDMCMessage>(capacity);
+        locally_stable_rdmc_messages[subgroup_num] = SequenceWindow<RDMCMessage>(capacity);
+        locally_stable_sst_messages[subgroup_num] = SequenceWindow<SSTMessage>(capacity);
+        non_persistent_messages[subgroup_num] = SequenceWindow<RDMCMessage>(capacity);
+        non_persistent_sst_messages[subgroup_num] = SequenceWindow<SSTMessage>(capacity);
+    }
+}
+
+/**
+ * An RDMC send cannot be timed without delivering a message, so its cost is
+ * estimated from the SST timings instead: a binomial pipeline takes
+ * ceil(log2(n)) + num_blocks - 1 steps, each a handshake and one block
+ * written to one member, while an SST send writes the whole message to the
+ * other n - 1 members at once. Rewriting the ring is harmless, since nothing
+ * has been sent yet and receivers only read what the ring's tail publishes.
+ */
+void MulticastGroup::calibrate_sst_send_thresholds() {
+    const uint32_t ring_size = sst::ring_size_for(window_size, sst_max_msg_size);
+    const long long unsigned int max_sst_msg_size = std::min<long long unsigned int>(max_msg_size, sst::max_msg_size);
+    const int num_repetitions = 5;
+    for(const auto& p : subgroup_to_shard_and_rank) {
+        const subgroup_id_t subgroup_num = p.first;
+        const SubgroupDescriptor& desc = subgroup_descriptors[subgroup_num];
+        if(desc.my_sender_rank < 0 || desc.num_members() < 2) {
+            continue;
+        }
+        // put offsets are relative to the start of a row, so take row 0's ring
+        const long long int ring_offset = (char*)(sst->ring[0] + subgroup_num * ring_size) - sst->getBaseAddress();
+        auto time_write = [&](long long unsigned int size) {
+            uint64_t best_ns = std::numeric_limits<uint64_t>::max();
+            for(int i = 0; i < num_repetitions; ++i) {
+                const uint64_t start_ns = steady_time_ns();
+                sst->put_with_completion(desc.shard_sst_indices, ring_offset, size);
+                best_ns = std::min(best_ns, steady_time_ns() - start_ns);
+            }
+            return (double)best_ns;
+        };
+        // fit a latency and a per-byte cost, for all members, to the extremes
+        const long long unsigned int min_size = sizeof(header);
+        const double min_size_ns = time_write(min_size);
+        const double max_size_ns = time_write(max_sst_msg_size);
+        const double latency_ns = min_size_ns;
+        const double ns_per_byte = std::max(max_size_ns - min_size_ns, 0.0) / (max_sst_msg_size - min_size);
+        const double num_other_members = desc.num_members() - 1;
+        const double tree_depth = std::ceil(std::log2(desc.num_members()));
+
+        long long unsigned int threshold = 0;
+        for(long long unsigned int size = min_size;; size = std::min(size * 2, max_sst_msg_size)) {
+            const double num_blocks = std::ceil((double)size / block_size);
+            const double block_bytes = std::min<double>(size, block_size);
+            const double rdmc_ns = (tree_depth + num_blocks - 1)
+                                   * (2 * latency_ns + block_bytes * ns_per_byte / num_other_members);
+            if(time_write(size) > rdmc_ns) {
+                break;
+            }
+            threshold = size - sizeof(header);
+            if(size == max_sst_msg_size) {
+                break;
+            }
+        }
+        set_sst_send_threshold(subgroup_num, threshold);
+        logger->debug("Calibrated the SST send threshold of subgroup {} to {} bytes", subgroup_num, threshold);
+    }
+}
+
+void MulticastGroup::initialize_message_buffers() {
+    spare_message_buffers.resize(buffer_class_sizes.size());
+    // A shard that shrank gives up the free buffers it no longer needs
+    for(auto& p : message_buffer_pools) {
+        const size_t max_buffers = window_size * subgroup_to_membership.at(p.first).size();
+        for(uint32_t size_class = 0; size_class < buffer_class_sizes.size(); ++size_class) {
+            auto& free_buffers = p.second.free_buffers[size_class];
+            while(p.second.num_buffers[size_class] > max_buffers && !free_buffers.empty()) {
+                spare_message_buffers[size_class].push_back(std::move(free_buffers.back()));
+                free_buffers.pop_back();
+                p.second.num_buffers[size_class]--;
+            }
+        }
+    }
+    // New pools start with a full window of the smallest buffers, so small
+    // messages never wait for an allocation; larger classes grow on demand
+    auto& spare_buffers = spare_message_buffers[0];
+    size_t num_missing = 0;
+    for(const auto& p : subgroup_to_shard_and_rank) {
+        if(message_buffer_pools.count(p.first) == 0) {
+            num_missing += window_size * subgroup_to_membership.at(p.first).size();
+        }
+    }
+    if(num_missing > spare_buffers.size()) {
+        std::vector<MessageBuffer> new_buffers = allocate_message_buffers(num_missing - spare_buffers.size(),
+                                                                          buffer_class_sizes[0]);
+        std::move(new_buffers.begin(), new_buffers.end(), std::back_inserter(spare_buffers));
+    }
+    for(const auto& p : subgroup_to_shard_and_rank) {
+        if(message_buffer_pools.count(p.first)) {
+            continue;
+        }
+        message_buffer_pool& pool = message_buffer_pools[p.first];
+        pool.free_buffers.resize(buffer_class_sizes.size());
+        pool.num_buffers.resize(buffer_class_sizes.size(), 0);
+        const size_t num_buffers = window_size * subgroup_to_membership.at(p.first).size();
+        while(pool.num_buffers[0] < num_buffers) {
+            pool.free_buffers[0].push_back(std::move(spare_buffers.back()));
+            spare_buffers.pop_back();
+            pool.num_buffers[0]++;
+        }
+    }
+}
+
+uint32_t MulticastGroup::buffer_class_of(size_t size) const {
+    uint32_t size_class = 0;
+    while(size_class + 1 < buffer_class_sizes.size() && buffer_class_sizes[size_class] < size) {
+        size_class++;
+    }
+    return size_class;
+}
+
+bool MulticastGroup::take_message_buffer(subgroup_id_t subgroup_num, size_t size, MessageBuffer& buffer) {
+    message_buffer_pool& pool = message_buffer_pools.at(subgroup_num);
+    const size_t max_buffers = window_size * subgroup_to_membership.at(subgroup_num).size();
+    // If a class has given out all its buffers, a larger one can stand in
+    for(uint32_t size_class = buffer_class_of(size); size_class < buffer_class_sizes.size(); ++size_class) {
+        auto& free_buffers = pool.free_buffers[size_class];
+        if(free_buffers.empty() && pool.num_buffers[size_class] < max_buffers) {
+            auto& spare_buffers = spare_message_buffers[size_class];
+            if(!spare_buffers.empty()) {
+                free_buffers.push_back(std::move(spare_buffers.back()));
+                spare_buffers.pop_back();
+                pool.num_buffers[size_class]++;
+            } else {
+                // Double the class with one new arena, so it only takes a
+                // few registrations to reach the window
+                const size_t num_new = std::min(max_buffers - pool.num_buffers[size_class],
+                                                std::max<size_t>(pool.num_buffers[size_class], 1));
+                free_buffers = allocate_message_buffers(num_new, buffer_class_sizes[size_class]);
+                pool.num_buffers[size_class] += num_new;
+            }
+        }
+        if(!free_buffers.empty()) {
+            buffer = std::move(free_buffers.back());
+            free_buffers.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @details
+ * The cap of window_size buffers per shard member bounds the messages a
+ * subgroup has in flight, but not the other buffers held at the same time:
+ * an aggregate while its messages are unpacked, and delivered messages
+ * waiting to be persisted or handed to the batch callback. A receiver
+ * cannot turn a message away, so it allocates past the cap in that case.
+ */
+MessageBuffer MulticastGroup::take_receive_buffer(subgroup_id_t subgroup_num, size_t size) {
+    MessageBuffer buffer;
+    if(!take_message_buffer(subgroup_num, size, buffer)) {
+        const uint32_t size_class = buffer_class_of(size);
+        logger->warn("Subgroup {} has no free buffer for a {}-byte message; growing its pool past the cap",
+                     subgroup_num, size);
+        std::vector<MessageBuffer> new_buffers = allocate_message_buffers(1, buffer_class_sizes[size_class]);
+        message_buffer_pools.at(subgroup_num).num_buffers[size_class]++;
+        buffer = std::move(new_buffers.back());
+    }
+    return buffer;
+}
+
+void MulticastGroup::release_message_buffer(subgroup_id_t subgroup_num, MessageBuffer&& buffer) {
+    // Placeholder messages of skipped turns have no buffer
+    if(!buffer.mr) {
+        return;
+    }
+    const uint32_t size_class = buffer_class_of(buffer.size);
+    auto pool = message_buffer_pools.find(subgroup_num);
+    if(pool != message_buffer_pools.end()) {
+        pool->second.free_buffers[size_class].push_back(std::move(buffer));
+    } else {
+        spare_message_buffers[size_class].push_back(std::move(buffer));
+    }
+}
+
+std::vector<MessageBuffer> MulticastGroup::allocate_message_buffers(size_t num_buffers, size_t buffer_size) {
+    std::vector<MessageBuffer> buffers;
+    if(num_buffers == 0 || buffer_size == 0) {
+        return buffers;
+    }
+    size_t arena_size = num_buffers * buffer_size;
+    void* arena = MAP_FAILED;
+    if(message_buffer_huge_pages) {
+        const size_t huge_page_size = 2 << 20;
+        const size_t huge_arena_size = (arena_size + huge_page_size - 1) & ~(huge_page_size - 1);
+        arena = mmap(nullptr, huge_arena_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(arena != MAP_FAILED) {
+            arena_size = huge_arena_size;
+        } else {
+            logger->warn("Could not map {} bytes of huge pages for message buffers, using normal pages", huge_arena_size);
+        }
+    }
+    if(arena == MAP_FAILED) {
+        arena = mmap(nullptr, arena_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(arena == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+    }
+    // The arena is unmapped once every buffer sliced from it is gone
+    std::shared_ptr<rdma::memory_region> mr(
+            new rdma::memory_region((char*)arena, arena_size),
+            [arena, arena_size](rdma::memory_region* mr) {
+                delete mr;
+                munmap(arena, arena_size);
+            });
+    buffers.reserve(num_buffers);
+    for(size_t i = 0; i < num_buffers; ++i) {
+        buffers.emplace_back(mr, i * buffer_size, buffer_size);
+    }
+    return buffers;
+}
+
 std::function<void(persistence::message)> MulticastGroup::make_file_written_callback() {
     return [this](persistence::message m) {
         callbacks.local_persistence_callback(m.subgroup_num, m.sender, m.index, m.data,
@@ -310,15 +630,14 @@ std::function<void(persistence::message)> MulticastGroup::make_file_written_call
             if(members[sender_rank] == m.sender) break;
         }
         // m.data points to the char[] buffer in a MessageBuffer, so we need to find
-        // the msg corresponding to m and put its MessageBuffer on free_message_buffers
+        // the msg corresponding to m and put its MessageBuffer back in its pool
         auto sequence_number = m.index * num_members + sender_rank;
         {
             std::lock_guard<std::mutex> lock(msg_state_mtx);
-            auto find_result = non_persistent_messages[m.subgroup_num].find(sequence_number);
-            assert(find_result != non_persistent_messages[m.subgroup_num].end());
-            RDMCMessage& m_msg = find_result->second;
-            free_message_buffers[m.subgroup_num].push_back(std::move(m_msg.message_buffer));
-            non_persistent_messages[m.subgroup_num].erase(find_result);
+            RDMCMessage* m_msg = non_persistent_messages[m.subgroup_num].find(sequence_number);
+            assert(m_msg);
+            release_message_buffer(m.subgroup_num, std::move(m_msg->message_buffer));
+            non_persistent_messages[m.subgroup_num].erase(sequence_number);
             sst->persisted_num[member_index][m.subgroup_num] = sequence_number;
             sst->put(get_shard_sst_indices(m.subgroup_num),
                      (char*)std::addressof(sst->persisted_num[0][m.subgroup_num]) - sst->getBaseAddress(),
@@ -337,8 +656,11 @@ bool MulticastGroup::create_rdmc_sst_groups() {
         std::vector<int> shard_senders;
         shard_senders = subgroup_to_senders_and_sender_rank.at(subgroup_num).first;
         num_shard_senders = get_num_senders(shard_senders);
-        auto shard_sst_indices = get_shard_sst_indices(subgroup_num);
-        sst_multicast_group_ptrs[subgroup_num] = std::make_unique<sst::multicast_group<DerechoSST>>(sst, shard_sst_indices, window_size, shard_senders, subgroup_to_num_received_offset.at(subgroup_num), window_size * subgroup_num);
+        const std::vector<uint32_t>& shard_sst_indices = get_shard_sst_indices(subgroup_num);
+        sst_multicast_group_ptrs[subgroup_num] = std::make_unique<sst::multicast_group<DerechoSST>>(
+                sst, shard_sst_indices, sst::ring_size_for(window_size, sst_max_msg_size), shard_senders,
+                subgroup_descriptors[subgroup_num].num_received_offset, subgroup_num, sst_max_msg_size,
+                sst_message_batching);
         for(uint shard_rank = 0, sender_rank = -1; shard_rank < num_shard_members; ++shard_rank) {
             // don't create RDMC group if the shard member is never going to send
             if(!shard_senders[shard_rank]) {
@@ -353,7 +675,7 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                                     node_id, num_shard_members, num_shard_senders,
                                     shard_sst_indices](char* data, size_t size) {
                 assert(this->sst);
-                uint32_t num_received_offset = subgroup_to_num_received_offset.at(subgroup_num);
+                const uint32_t num_received_offset = subgroup_descriptors[subgroup_num].num_received_offset;
                 std::lock_guard<std::mutex> lock(msg_state_mtx);
                 header* h = (header*)data;
                 long long int index = h->index;
@@ -363,64 +685,69 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                 logger->debug("Locally received message in subgroup {}, sender rank {}, index {}", subgroup_num, shard_rank, index);
 
                 // Move message from current_receives to locally_stable_rdmc_messages.
+                RDMCMessage received;
                 if(node_id == members[member_index]) {
+                    std::lock_guard<std::mutex> send_lock(sender_threads[subgroup_to_sender_thread[subgroup_num]]->mtx);
                     assert(current_sends[subgroup_num]);
-                    locally_stable_rdmc_messages[subgroup_num][sequence_number] = std::move(*current_sends[subgroup_num]);
+                    received = std::move(*current_sends[subgroup_num]);
                     current_sends[subgroup_num] = std::experimental::nullopt;
                 } else {
-                    auto it = current_receives.find({subgroup_num, sequence_number});
-                    assert(it != current_receives.end());
-                    auto& message = it->second;
-                    locally_stable_rdmc_messages[subgroup_num].emplace(sequence_number, std::move(message));
-                    current_receives.erase(it);
+                    RDMCMessage* message = current_receives[subgroup_num].find(sequence_number);
+                    assert(message);
+                    received = std::move(*message);
+                    current_receives[subgroup_num].erase(sequence_number);
                 }
-                // Add empty messages to locally_stable_rdmc_messages for each turn that the sender is skipping.
-                for(unsigned int j = 0; j < h->pause_sending_turns; ++j) {
-                    index++;
-                    sequence_number += num_shard_senders;
-                    locally_stable_rdmc_messages[subgroup_num][sequence_number] = {node_id, index, 0, 0};
+                if(h->aggregated) {
+                    index = unpack_aggregated_message(subgroup_num, sender_rank, num_shard_senders, std::move(received));
+                } else {
+                    locally_stable_rdmc_messages[subgroup_num].insert(sequence_number, std::move(received));
+                    // Add empty messages to locally_stable_rdmc_messages for each turn that the sender is skipping.
+                    for(unsigned int j = 0; j < h->pause_sending_turns; ++j) {
+                        index++;
+                        sequence_number += num_shard_senders;
+                        locally_stable_rdmc_messages[subgroup_num].insert(sequence_number, {node_id, index, 0, {}});
+                    }
                 }
 
                 auto new_num_received = resolve_num_received(beg_index, index, num_received_offset + sender_rank);
                 // deliver immediately if in raw mode
-                if(subgroup_to_mode.at(subgroup_num) == Mode::RAW) {
+                if(subgroup_descriptors[subgroup_num].mode == Mode::RAW) {
                     // issue stability upcalls for the recently sequenced messages
                     for(uint i = sst->num_received[member_index][num_received_offset + sender_rank] + 1; i <= new_num_received; ++i) {
                         auto seq_num = i * num_shard_senders + sender_rank;
-                        if(!locally_stable_sst_messages[subgroup_num].empty()
-                           && locally_stable_sst_messages[subgroup_num].begin()->first == seq_num) {
-                            auto& msg = locally_stable_sst_messages[subgroup_num].begin()->second;
+                        if(SSTMessage* sst_msg = locally_stable_sst_messages[subgroup_num].find(seq_num)) {
+                            auto& msg = *sst_msg;
                             if(msg.size > 0) {
                                 char* buf = const_cast<char*>(msg.buf);
                                 header* h = (header*)(buf);
                                 callbacks.global_stability_callback(subgroup_num, msg.sender_id,
                                                                     msg.index, buf + h->header_size,
                                                                     msg.size - h->header_size);
+                                num_sst_messages_delivered++;
                             }
-                            locally_stable_sst_messages[subgroup_num].erase(locally_stable_sst_messages[subgroup_num].begin());
+                            locally_stable_sst_messages[subgroup_num].erase(seq_num);
                         } else {
-                            assert(!locally_stable_rdmc_messages[subgroup_num].empty());
-                            auto it2 = locally_stable_rdmc_messages[subgroup_num].begin();
-                            assert(it2->first == seq_num);
-                            auto& msg = it2->second;
+                            RDMCMessage* rdmc_msg = locally_stable_rdmc_messages[subgroup_num].find(seq_num);
+                            assert(rdmc_msg);
+                            auto& msg = *rdmc_msg;
                             if(msg.size > 0) {
-                                char* buf = msg.message_buffer.buffer.get();
+                                char* buf = msg.message_buffer.get();
                                 header* h = (header*)(buf);
                                 callbacks.global_stability_callback(subgroup_num, msg.sender_id,
                                                                     msg.index, buf + h->header_size,
                                                                     msg.size - h->header_size);
-                                free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
+                                release_message_buffer(subgroup_num, std::move(msg.message_buffer));
                             }
-                            locally_stable_rdmc_messages[subgroup_num].erase(it2);
+                            locally_stable_rdmc_messages[subgroup_num].erase(seq_num);
                         }
                     }
                 }
                 if(new_num_received > sst->num_received[member_index][num_received_offset + sender_rank]) {
                     sst->num_received[member_index][num_received_offset + sender_rank] = new_num_received;
                     // std::atomic_signal_fence(std::memory_order_acq_rel);
-                    auto* min_ptr = std::min_element(&sst->num_received[member_index][num_received_offset],
-                                                     &sst->num_received[member_index][num_received_offset + num_shard_senders]);
-                    uint min_index = std::distance(&sst->num_received[member_index][num_received_offset], min_ptr);
+                    auto* num_received_begin = &sst->num_received[member_index][num_received_offset];
+                    auto* min_ptr = std::min_element(num_received_begin, num_received_begin + num_shard_senders);
+                    uint min_index = std::distance(num_received_begin, min_ptr);
                     auto new_seq_num = (*min_ptr + 1) * num_shard_senders + min_index - 1;
                     if((long long int)new_seq_num > sst->seq_num[member_index][subgroup_num]) {
                         logger->debug("Updating seq_num for subgroup {} to {}", subgroup_num, new_seq_num);
@@ -443,10 +770,10 @@ bool MulticastGroup::create_rdmc_sst_groups() {
             };
             // Capture rdmc_receive_handler by copy! The reference to it won't be valid after this constructor ends!
             auto receive_handler_plus_notify =
-                    [this, rdmc_receive_handler](char* data, size_t size) {
+                    [this, rdmc_receive_handler, subgroup_num](char* data, size_t size) {
                         rdmc_receive_handler(data, size);
                         // signal background writer thread
-                        sender_cv.notify_all();
+                        notify_sender_thread(subgroup_num);
                     };
 
             // Create a "rotated" vector of members in which the currently selected shard member (shard_rank) is first
@@ -479,18 +806,16 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                            rdmc_group_num_offset, rotated_shard_members, block_size, type,
                            [this, subgroup_num, node_id, sender_rank, num_shard_senders](size_t length) {
                                std::lock_guard<std::mutex> lock(msg_state_mtx);
-                               assert(!free_message_buffers[subgroup_num].empty());
                                //Create a Message struct to receive the data into.
                                RDMCMessage msg;
                                msg.sender_id = node_id;
-                               msg.index = sst->num_received[member_index][subgroup_to_num_received_offset.at(subgroup_num) + sender_rank] + 1;
+                               msg.index = sst->num_received[member_index][subgroup_descriptors[subgroup_num].num_received_offset + sender_rank] + 1;
                                msg.size = length;
-                               msg.message_buffer = std::move(free_message_buffers[subgroup_num].back());
-                               free_message_buffers[subgroup_num].pop_back();
+                               msg.message_buffer = take_receive_buffer(subgroup_num, length);
 
-                               rdmc::receive_destination ret{msg.message_buffer.mr, 0};
+                               rdmc::receive_destination ret{msg.message_buffer.mr, msg.message_buffer.offset};
                                auto sequence_number = msg.index * num_shard_senders + sender_rank;
-                               current_receives[{subgroup_num, sequence_number}] = std::move(msg);
+                               current_receives[subgroup_num].insert(sequence_number, std::move(msg));
 
                                assert(ret.mr->buffer != nullptr);
                                return ret;
@@ -528,20 +853,91 @@ void MulticastGroup::initialize_sst_row() {
     sst->sync_with_members();
 }
 
+bool MulticastGroup::aggregate_pending_send(subgroup_id_t subgroup_num, RDMCMessage& msg) {
+    auto& queue = pending_sends[subgroup_num];
+    const long long unsigned int entry_len = sst::batch_entry_len(msg.size);
+    if(queue.empty() || sizeof(header) + entry_len > rdmc_send_aggregation_size) {
+        return false;
+    }
+    RDMCMessage& last = queue.back();
+    auto append = [](RDMCMessage& aggregate, const RDMCMessage& packed_msg) {
+        char* entry = aggregate.message_buffer.get() + aggregate.size;
+        *(uint32_t*)entry = packed_msg.size;
+        memcpy(entry + sizeof(uint32_t), packed_msg.message_buffer.get(), packed_msg.size);
+        aggregate.size += sst::batch_entry_len(packed_msg.size);
+    };
+    if(!((header*)last.message_buffer.get())->aggregated) {
+        // the last queued message starts a new aggregate, if both fit in one
+        if(sizeof(header) + sst::batch_entry_len(last.size) + entry_len > rdmc_send_aggregation_size) {
+            return false;
+        }
+        RDMCMessage aggregate;
+        if(!take_message_buffer(subgroup_num, rdmc_send_aggregation_size, aggregate.message_buffer)) {
+            return false;
+        }
+        aggregate.sender_id = last.sender_id;
+        aggregate.index = last.index;
+        aggregate.size = sizeof(header);
+        header* h = (header*)aggregate.message_buffer.get();
+        h->header_size = sizeof(header);
+        h->pause_sending_turns = 0;
+        h->index = last.index;
+        h->cooked_send = false;
+        h->aggregated = true;
+        append(aggregate, last);
+        release_message_buffer(subgroup_num, std::move(last.message_buffer));
+        last = std::move(aggregate);
+    } else if(last.size + entry_len > rdmc_send_aggregation_size) {
+        return false;
+    }
+    append(last, msg);
+    release_message_buffer(subgroup_num, std::move(msg.message_buffer));
+    return true;
+}
+
+long long int MulticastGroup::unpack_aggregated_message(subgroup_id_t subgroup_num, uint32_t sender_rank,
+                                                        uint32_t num_shard_senders, RDMCMessage&& aggregate) {
+    char* buf = aggregate.message_buffer.get();
+    long long int index = ((header*)buf)->index - 1;
+    sst::for_each_batched_message(buf + sizeof(header), aggregate.size - sizeof(header),
+                                  [&](volatile char* packed_msg, uint32_t size) {
+                                      header* h = (header*)packed_msg;
+                                      RDMCMessage msg;
+                                      msg.sender_id = aggregate.sender_id;
+                                      msg.index = index = h->index;
+                                      msg.size = size;
+                                      msg.message_buffer = take_receive_buffer(subgroup_num, size);
+                                      memcpy(msg.message_buffer.get(), (char*)packed_msg, size);
+                                      long long int sequence_number = index * num_shard_senders + sender_rank;
+                                      locally_stable_rdmc_messages[subgroup_num].insert(sequence_number, std::move(msg));
+                                      // Add empty messages for each turn that the sender is skipping.
+                                      for(unsigned int j = 0; j < h->pause_sending_turns; ++j) {
+                                          index++;
+                                          sequence_number += num_shard_senders;
+                                          locally_stable_rdmc_messages[subgroup_num].insert(
+                                                  sequence_number, {aggregate.sender_id, index, 0, {}});
+                                      }
+                                  });
+    release_message_buffer(subgroup_num, std::move(aggregate.message_buffer));
+    return index;
+}
+
 void MulticastGroup::deliver_message(RDMCMessage& msg, subgroup_id_t subgroup_num) {
     if(msg.size > 0) {
-        char* buf = msg.message_buffer.buffer.get();
+        char* buf = msg.message_buffer.get();
         header* h = (header*)(buf);
         // cooked send
         if(h->cooked_send) {
             buf += h->header_size;
             auto payload_size = msg.size - h->header_size;
+            // messages batched so far must be handed over before this one
+            flush_delivery_batch(subgroup_num);
             rpc_callback(subgroup_num, msg.sender_id, buf, payload_size);
         }
         // raw send
         else {
-            callbacks.global_stability_callback(subgroup_num, msg.sender_id, msg.index,
-                                                buf + h->header_size, msg.size - h->header_size);
+            stability_upcall(subgroup_num, msg.sender_id, msg.index,
+                             buf + h->header_size, msg.size - h->header_size);
         }
         if(file_writer) {
             persistence::message msg_for_filewriter{buf + h->header_size,
@@ -549,21 +945,15 @@ void MulticastGroup::deliver_message(RDMCMessage& msg, subgroup_id_t subgroup_nu
                                                     msg.sender_id, (uint64_t)msg.index,
                                                     h->cooked_send};
             //the sequence number needs to use the sender's within-shard rank, not its ID
-            auto& shard_members = subgroup_to_membership.at(subgroup_num);
-            std::vector<int> shard_senders = subgroup_to_senders_and_sender_rank.at(subgroup_num).first;
-            auto num_shard_senders = get_num_senders(shard_senders);
-            uint shard_rank;
-            uint sender_rank = 0;
-            for(shard_rank = 0; shard_rank < shard_members.size(); ++shard_rank) {
-                if(shard_members[shard_rank] == msg.sender_id) break;
-                if(shard_senders[shard_rank])
-                    sender_rank++;
-            }
-            auto sequence_number = msg.index * num_shard_senders + sender_rank;
-            non_persistent_messages[subgroup_num].emplace(sequence_number, std::move(msg));
+            const SubgroupDescriptor& desc = subgroup_descriptors[subgroup_num];
+            auto sequence_number = msg.index * desc.num_senders() + desc.sender_rank_of(msg.sender_id);
+            non_persistent_messages[subgroup_num].insert(sequence_number, std::move(msg));
             file_writer->write_message(msg_for_filewriter);
+        } else if(!h->cooked_send && callbacks.global_stability_batch_callback) {
+            // the batch still points into the buffer
+            delivery_batch_buffers.push_back(std::move(msg.message_buffer));
         } else {
-            free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
+            release_message_buffer(subgroup_num, std::move(msg.message_buffer));
         }
     }
 }
@@ -571,19 +961,22 @@ void MulticastGroup::deliver_message(RDMCMessage& msg, subgroup_id_t subgroup_nu
 void MulticastGroup::deliver_message(SSTMessage& msg, subgroup_id_t subgroup_num) {
     // DERECHO_LOG(-1, -1, "deliver_message()");
     if(msg.size > 0) {
+        num_sst_messages_delivered++;
         char* buf = const_cast<char*>(msg.buf);
         header* h = (header*)(buf);
         // cooked send
         if(h->cooked_send) {
             buf += h->header_size;
             auto payload_size = msg.size - h->header_size;
+            // messages batched so far must be handed over before this one
+            flush_delivery_batch(subgroup_num);
             rpc_callback(subgroup_num, msg.sender_id, buf, payload_size);
         }
         // raw send
         else {
             // DERECHO_LOG(-1, -1, "start_stability_callback");
-            callbacks.global_stability_callback(subgroup_num, msg.sender_id, msg.index,
-                                                buf + h->header_size, msg.size - h->header_size);
+            stability_upcall(subgroup_num, msg.sender_id, msg.index,
+                             buf + h->header_size, msg.size - h->header_size);
             // DERECHO_LOG(-1, -1, "end_stability_callback");
         }
         if(file_writer) {
@@ -592,23 +985,44 @@ void MulticastGroup::deliver_message(SSTMessage& msg, subgroup_id_t subgroup_num
                                                     msg.sender_id, (uint64_t)msg.index,
                                                     h->cooked_send};
             //the sequence number needs to use the sender's within-shard rank, not its ID
-            auto& shard_members = subgroup_to_membership.at(subgroup_num);
-            std::vector<int> shard_senders = subgroup_to_senders_and_sender_rank.at(subgroup_num).first;
-            auto num_shard_senders = get_num_senders(shard_senders);
-            uint shard_rank;
-            uint sender_rank = 0;
-            for(shard_rank = 0; shard_rank < shard_members.size(); ++shard_rank) {
-                if(shard_members[shard_rank] == msg.sender_id) break;
-                if(shard_senders[shard_rank])
-                    sender_rank++;
-            }
-            auto sequence_number = msg.index * num_shard_senders + sender_rank;
-            non_persistent_sst_messages[subgroup_num].emplace(sequence_number, std::move(msg));
+            const SubgroupDescriptor& desc = subgroup_descriptors[subgroup_num];
+            auto sequence_number = msg.index * desc.num_senders() + desc.sender_rank_of(msg.sender_id);
+            non_persistent_sst_messages[subgroup_num].insert(sequence_number, std::move(msg));
             file_writer->write_message(msg_for_filewriter);
         }
     }
 }
 
+void MulticastGroup::stability_upcall(subgroup_id_t subgroup_num, node_id_t sender_id,
+                                      long long int index, char* data, long long int size) {
+    if(callbacks.global_stability_batch_callback) {
+        delivery_batch.push_back({sender_id, index, data, size});
+    } else {
+        callbacks.global_stability_callback(subgroup_num, sender_id, index, data, size);
+    }
+}
+
+/**
+ * @details
+ * Batched messages stay valid until the batch is handed over. delivered_num
+ * is only written afterwards, so their SST ring entries cannot be reused
+ * before then. Their RDMC buffers are held in delivery_batch_buffers, or,
+ * when messages are persisted, in non_persistent_messages, which the file
+ * writer's callback only releases under msg_state_mtx, held from delivery
+ * until the batch is flushed.
+ */
+void MulticastGroup::flush_delivery_batch(subgroup_id_t subgroup_num) {
+    if(delivery_batch.empty()) {
+        return;
+    }
+    callbacks.global_stability_batch_callback(subgroup_num, delivery_batch);
+    delivery_batch.clear();
+    for(auto& buffer : delivery_batch_buffers) {
+        release_message_buffer(subgroup_num, std::move(buffer));
+    }
+    delivery_batch_buffers.clear();
+}
+
 void MulticastGroup::deliver_messages_upto(
         const std::vector<long long int>& max_indices_for_senders,
         subgroup_id_t subgroup_num, uint32_t num_shard_senders) {
@@ -623,63 +1037,55 @@ void MulticastGroup::deliver_messages_upto(
     }
     // DERECHO_LOG(-1, -1, "deliver_messages_upto_loop");
     for(auto seq_num = curr_seq_num; seq_num <= max_seq_num; seq_num++) {
-        auto msg_ptr = locally_stable_rdmc_messages[subgroup_num].find(seq_num);
-        if(msg_ptr != locally_stable_rdmc_messages[subgroup_num].end()) {
-            deliver_message(msg_ptr->second, subgroup_num);
+        RDMCMessage* msg_ptr = locally_stable_rdmc_messages[subgroup_num].find(seq_num);
+        if(msg_ptr) {
+            deliver_message(*msg_ptr, subgroup_num);
             // DERECHO_LOG(-1, -1, "erase_message");
-            locally_stable_rdmc_messages[subgroup_num].erase(msg_ptr);
+            locally_stable_rdmc_messages[subgroup_num].erase(seq_num);
             // DERECHO_LOG(-1, -1, "erase_message_done");
         } else {
-            auto sst_msg_ptr = locally_stable_sst_messages[subgroup_num].find(seq_num);
-            if(sst_msg_ptr != locally_stable_sst_messages[subgroup_num].end()) {
-                deliver_message(sst_msg_ptr->second, subgroup_num);
+            SSTMessage* sst_msg_ptr = locally_stable_sst_messages[subgroup_num].find(seq_num);
+            if(sst_msg_ptr) {
+                deliver_message(*sst_msg_ptr, subgroup_num);
                 // DERECHO_LOG(-1, -1, "erase_message");
-                locally_stable_sst_messages[subgroup_num].erase(sst_msg_ptr);
+                locally_stable_sst_messages[subgroup_num].erase(seq_num);
                 // DERECHO_LOG(-1, -1, "erase_message_done");
             }
         }
     }
+    flush_delivery_batch(subgroup_num);
 }
 
 void MulticastGroup::register_predicates() {
     for(const auto& p : subgroup_to_shard_and_rank) {
         subgroup_id_t subgroup_num = p.first;
-        uint32_t shard_num, shard_index;
-        std::tie(shard_num, shard_index) = p.second;
-        std::vector<node_id_t> shard_members = subgroup_to_membership.at(subgroup_num);
-        auto num_shard_members = shard_members.size();
-        auto num_received_offset = subgroup_to_num_received_offset.at(subgroup_num);
-        std::vector<int> shard_senders = subgroup_to_senders_and_sender_rank.at(subgroup_num).first;
-        auto num_shard_senders = get_num_senders(shard_senders);
-        std::map<uint32_t, uint32_t> shard_ranks_by_sender_rank;
-        for(uint j = 0, l = 0; j < num_shard_members; ++j) {
-            if(shard_senders[j]) {
-                shard_ranks_by_sender_rank[l] = j;
-                l++;
-            }
-        }
-
-        auto receiver_pred = [this, subgroup_num, shard_members, num_shard_members,
-                              shard_ranks_by_sender_rank, num_shard_senders,
-                              num_received_offset](const DerechoSST& sst) {
-            for(uint j = 0; j < num_shard_senders; ++j) {
-                auto num_received = sst.num_received_sst[member_index][num_received_offset + j] + 1;
-                uint32_t slot = num_received % window_size;
-                if((long long int)sst.slots[node_id_to_sst_index.at(shard_members[shard_ranks_by_sender_rank.at(j)])]
-                                           [subgroup_num * window_size + slot]
-                                                   .next_seq
-                   == num_received / window_size + 1) {
+        const SubgroupDescriptor& desc = subgroup_descriptors[subgroup_num];
+        const uint32_t num_shard_senders = desc.num_senders();
+        const uint32_t num_received_offset = desc.num_received_offset;
+        // each subgroup's predicates are evaluated in order, by a single thread,
+        // independently of other subgroups and of the view management predicates
+        const uint32_t predicate_group = subgroup_num + 1;
+
+        const uint32_t ring_size = sst::ring_size_for(window_size, sst_max_msg_size);
+        sst_ring_readers[subgroup_num].assign(num_shard_senders, sst::ring_reader());
+        sst_ack_state& ack_state = sst_ack_states[subgroup_num];
+        ack_state.num_received_offset = num_received_offset;
+        ack_state.num_senders = num_shard_senders;
+        ack_state.num_unacked_by_sender.assign(num_shard_senders, 0);
+        auto receiver_pred = [this, subgroup_num, &desc](const DerechoSST& sst) {
+            for(uint j = 0; j < desc.num_senders(); ++j) {
+                if(sst_ring_readers[subgroup_num][j].ready(sst.ring_tail[desc.sender_sst_indices[j]][subgroup_num])) {
                     return true;
                 }
             }
-            return false;
+            // held back acknowledgements whose time is up
+            return sst_ack_states[subgroup_num].num_unacked > 0 && sst_acks_due(sst_ack_states[subgroup_num]);
         };
         auto num_times = window_size / 2;
         if(!num_times) {
             num_times = 1;
         }
-        auto sst_receive_handler = [this, subgroup_num, shard_members, num_shard_members,
-                                    shard_ranks_by_sender_rank, num_shard_senders,
+        auto sst_receive_handler = [this, subgroup_num, &desc, num_shard_senders,
                                     num_received_offset](uint32_t sender_rank, uint64_t index_ignored,
                                                          volatile char* data, uint32_t size) {
             header* h = (header*)data;
@@ -688,114 +1094,118 @@ void MulticastGroup::register_predicates() {
             long long int sequence_number = index * num_shard_senders + sender_rank;
             logger->debug("Locally received message in subgroup {}, sender rank {}, index {}", subgroup_num, sender_rank, index);
 
-            auto node_id = shard_members[shard_ranks_by_sender_rank.at(sender_rank)];
+            auto node_id = desc.sender_ids[sender_rank];
 
             // DERECHO_LOG(node_id, index, "received_message");
-            locally_stable_sst_messages[subgroup_num][sequence_number] = {node_id, index, size, data};
+            locally_stable_sst_messages[subgroup_num].insert(sequence_number, {node_id, index, size, data});
 
             // Add empty messages to locally_stable_sst_messages for each turn that the sender is skipping.
             for(unsigned int j = 0; j < h->pause_sending_turns; ++j) {
                 index++;
                 sequence_number += num_shard_senders;
-                locally_stable_sst_messages[subgroup_num][sequence_number] = {node_id, index, 0, 0};
+                locally_stable_sst_messages[subgroup_num].insert(sequence_number, {node_id, index, 0, {}});
             }
 
             auto new_num_received = resolve_num_received(beg_index, index, num_received_offset + sender_rank);
-            if(subgroup_to_mode.at(subgroup_num) == Mode::RAW) {
+            if(desc.mode == Mode::RAW) {
                 // issue stability upcalls for the recently sequenced messages
                 for(uint i = sst->num_received[member_index][num_received_offset + sender_rank] + 1; i <= new_num_received; ++i) {
                     auto seq_num = i * num_shard_senders + sender_rank;
-                    if(!locally_stable_sst_messages[subgroup_num].empty()
-                       && locally_stable_sst_messages[subgroup_num].begin()->first == seq_num) {
-                        auto& msg = locally_stable_sst_messages[subgroup_num].begin()->second;
+                    if(SSTMessage* sst_msg = locally_stable_sst_messages[subgroup_num].find(seq_num)) {
+                        auto& msg = *sst_msg;
                         if(msg.size > 0) {
                             char* buf = const_cast<char*>(msg.buf);
                             header* h = (header*)(buf);
                             callbacks.global_stability_callback(subgroup_num, msg.sender_id,
                                                                 msg.index, buf + h->header_size,
                                                                 msg.size - h->header_size);
+                            num_sst_messages_delivered++;
                         }
-                        locally_stable_sst_messages[subgroup_num].erase(locally_stable_sst_messages[subgroup_num].begin());
+                        locally_stable_sst_messages[subgroup_num].erase(seq_num);
                     } else {
-                        assert(!locally_stable_rdmc_messages[subgroup_num].empty());
-                        auto it2 = locally_stable_rdmc_messages[subgroup_num].begin();
-                        assert(it2->first == seq_num);
-                        auto& msg = it2->second;
+                        RDMCMessage* rdmc_msg = locally_stable_rdmc_messages[subgroup_num].find(seq_num);
+                        assert(rdmc_msg);
+                        auto& msg = *rdmc_msg;
                         if(msg.size > 0) {
-                            char* buf = msg.message_buffer.buffer.get();
+                            char* buf = msg.message_buffer.get();
                             header* h = (header*)(buf);
                             callbacks.global_stability_callback(subgroup_num, msg.sender_id,
                                                                 msg.index, buf + h->header_size,
                                                                 msg.size - h->header_size);
-                            free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
+                            release_message_buffer(subgroup_num, std::move(msg.message_buffer));
                         }
-                        locally_stable_rdmc_messages[subgroup_num].erase(it2);
+                        locally_stable_rdmc_messages[subgroup_num].erase(seq_num);
                     }
                 }
             }
             sst->num_received[member_index][num_received_offset + sender_rank] = new_num_received;
         };
         uint64_t receiver_cnt = 0;
-        auto receiver_trig = [this, num_times, sst_receive_handler, subgroup_num, shard_members,
-                              num_shard_members, shard_ranks_by_sender_rank,
-                              num_shard_senders, num_received_offset, receiver_cnt](DerechoSST& sst) mutable {
+        auto receiver_trig = [this, num_times, sst_receive_handler, subgroup_num, &desc,
+                              num_shard_senders, num_received_offset, ring_size, receiver_cnt,
+                              &ack_state](DerechoSST& sst) mutable {
             receiver_cnt++;
             // DERECHO_LOG(receiver_cnt, -1, "in receiver_trig");
             std::lock_guard<std::mutex> lock(msg_state_mtx);
             for(uint i = 0; i < num_times; ++i) {
                 for(uint j = 0; j < num_shard_senders; ++j) {
                     auto num_received = sst.num_received_sst[member_index][num_received_offset + j] + 1;
-                    uint32_t slot = num_received % window_size;
-                    long long int next_seq = (long long int)sst.slots[node_id_to_sst_index.at(shard_members[shard_ranks_by_sender_rank.at(j)])][subgroup_num * window_size + slot].next_seq;
-                    if(next_seq == num_received / window_size + 1) {
-                        sst_receive_handler(j, num_received,
-                                            sst.slots[node_id_to_sst_index.at(shard_members[shard_ranks_by_sender_rank.at(j)])][subgroup_num * window_size + slot].buf,
-                                            sst.slots[node_id_to_sst_index.at(shard_members[shard_ranks_by_sender_rank.at(j)])][subgroup_num * window_size + slot].size);
+                    const uint32_t sender_row = desc.sender_sst_indices[j];
+                    sst::ring_reader& reader = sst_ring_readers[subgroup_num][j];
+                    if(reader.ready(sst.ring_tail[sender_row][subgroup_num])) {
+                        volatile char* data;
+                        uint32_t size;
+                        std::tie(data, size) = reader.next(sst.ring[sender_row] + subgroup_num * ring_size, ring_size);
+                        if(sst_message_batching) {
+                            // deliver each packed message as if it had an entry of its own
+                            sst::for_each_batched_message(data, size,
+                                                          [&](volatile char* message, uint32_t message_size) {
+                                                              sst_receive_handler(j, num_received, message, message_size);
+                                                          });
+                        } else {
+                            sst_receive_handler(j, num_received, data, size);
+                        }
                         sst.num_received_sst[member_index][num_received_offset + j] = num_received;
+                        if(ack_state.num_unacked++ == 0) {
+                            ack_state.oldest_unacked_ns = steady_time_ns();
+                        }
+                        ack_state.num_unacked_by_sender[j]++;
                     }
                 }
             }
-            sst.put((char*)std::addressof(sst.num_received_sst[0][num_received_offset]) - sst.getBaseAddress(),
-                    sizeof(sst.num_received_sst[0][0]) * num_shard_senders);
             // std::atomic_signal_fence(std::memory_order_acq_rel);
-            auto* min_ptr = std::min_element(&sst.num_received[member_index][num_received_offset],
-                                             &sst.num_received[member_index][num_received_offset + num_shard_senders]);
-            int min_index = std::distance(&sst.num_received[member_index][num_received_offset], min_ptr);
+            auto* num_received_begin = &sst.num_received[member_index][num_received_offset];
+            auto* min_ptr = std::min_element(num_received_begin, num_received_begin + num_shard_senders);
+            int min_index = std::distance(num_received_begin, min_ptr);
             auto new_seq_num = (*min_ptr + 1) * num_shard_senders + min_index - 1;
             if(new_seq_num > sst.seq_num[member_index][subgroup_num]) {
                 logger->debug("Updating seq_num for subgroup {} to {}", subgroup_num, new_seq_num);
                 sst.seq_num[member_index][subgroup_num] = new_seq_num;
-                sst.put((char*)std::addressof(sst.seq_num[0][subgroup_num]) - sst.getBaseAddress(),
-                        sizeof(long long int));
+                ack_state.seq_num_changed = true;
+            }
+            if(sst_acks_due(ack_state)) {
+                send_sst_acks(subgroup_num);
             }
-            sst.put((char*)std::addressof(sst.num_received[0][num_received_offset]) - sst.getBaseAddress(),
-                    sizeof(long long int) * num_shard_senders);
         };
         receiver_pred_handles.emplace_back(sst->predicates.insert(receiver_pred, receiver_trig,
-                                                                  sst::PredicateType::RECURRENT));
+                                                                  sst::PredicateType::RECURRENT,
+                                                                  {}, predicate_group));
 
-        if(subgroup_to_mode.at(subgroup_num) != Mode::RAW) {
+        if(desc.mode != Mode::RAW) {
             auto stability_pred = [this](
                     const DerechoSST& sst) { return true; };
-            auto shard_sst_indices = get_shard_sst_indices(subgroup_num);
             auto stability_trig =
-                    [this, subgroup_num, shard_members, num_shard_members, shard_sst_indices](DerechoSST& sst) mutable {
+                    [this, subgroup_num, &desc](DerechoSST& sst) mutable {
                         // DERECHO_LOG(stability_cnt, -1, "in stability_trig");
                         // compute the min of the seq_num
-                        long long int min_seq_num
-                                = sst.seq_num[node_id_to_sst_index.at(shard_members[0])][subgroup_num];
-                        for(uint i = 0; i < num_shard_members; ++i) {
-                            if(sst.seq_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num] < min_seq_num) {
-                                min_seq_num
-                                        = sst.seq_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num];
-                            }
-                        }
+                        const long long int min_seq_num = sst::column_min(
+                                (volatile char*)std::addressof(sst.seq_num[0][subgroup_num]), desc.shard_row_offsets);
                         if(min_seq_num > sst.stable_num[member_index][subgroup_num]) {
                             logger->debug("Subgroup {}, updating stable_num to {}", subgroup_num, min_seq_num);
                             sst.stable_num[member_index][subgroup_num] = min_seq_num;
                             // DERECHO_LOG(stability_cnt, min_seq_num, "stability_trig");
                             // DERECHO_LOG(-1, -1, "stability_put_start");
-                            sst.put(shard_sst_indices,
+                            sst.put(desc.shard_sst_indices,
                                     (char*)std::addressof(sst.stable_num[0][subgroup_num]) - sst.getBaseAddress(),
                                     sizeof(long long int));
                             // DERECHO_LOG(-1, -1, "stability_put_end");
@@ -803,112 +1213,97 @@ void MulticastGroup::register_predicates() {
                         }
                     };
             stability_pred_handles.emplace_back(sst->predicates.insert(
-                    stability_pred, stability_trig, sst::PredicateType::RECURRENT));
+                    stability_pred, stability_trig, sst::PredicateType::RECURRENT, {}, predicate_group));
 
             auto delivery_pred = [this](
                     const DerechoSST& sst) { return true; };
-            auto delivery_trig = [this, subgroup_num, shard_members, num_shard_members](
+            auto delivery_trig = [this, subgroup_num, &desc](
                     DerechoSST& sst) mutable {
                 // DERECHO_LOG(delivery_cnt, -1, "in delivery_trig");
                 std::lock_guard<std::mutex> lock(msg_state_mtx);
                 // compute the min of the stable_num
-                long long int min_stable_num
-                        = sst.stable_num[node_id_to_sst_index.at(shard_members[0])][subgroup_num];
-                for(uint i = 0; i < num_shard_members; ++i) {
-                    if(sst.stable_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num] < min_stable_num) {
-                        min_stable_num = sst.stable_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num];
-                    }
-                }
-
-                bool update_sst = false;
-                while(true) {
-                    if(locally_stable_rdmc_messages[subgroup_num].empty() && locally_stable_sst_messages[subgroup_num].empty()) {
-                        break;
-                    }
-                    long long int least_undelivered_rdmc_seq_num, least_undelivered_sst_seq_num;
-                    least_undelivered_rdmc_seq_num = least_undelivered_sst_seq_num = std::numeric_limits<long long int>::max();
-                    if(!locally_stable_rdmc_messages[subgroup_num].empty()) {
-                        least_undelivered_rdmc_seq_num = locally_stable_rdmc_messages[subgroup_num].begin()->first;
-                    }
-                    if(!locally_stable_sst_messages[subgroup_num].empty()) {
-                        least_undelivered_sst_seq_num = locally_stable_sst_messages[subgroup_num].begin()->first;
-                    }
-                    if(least_undelivered_rdmc_seq_num < least_undelivered_sst_seq_num && least_undelivered_rdmc_seq_num <= min_stable_num) {
-                        update_sst = true;
+                const long long int min_stable_num = sst::column_min(
+                        (volatile char*)std::addressof(sst.stable_num[0][subgroup_num]), desc.shard_row_offsets);
+
+                // every message up to min_stable_num has been received, by one medium or the other
+                const long long int first_undelivered = sst.delivered_num[member_index][subgroup_num] + 1;
+                long long int last_delivered = first_undelivered - 1;
+                for(long long int seq_num = first_undelivered; seq_num <= min_stable_num; ++seq_num) {
+                    if(RDMCMessage* rdmc_msg = locally_stable_rdmc_messages[subgroup_num].find(seq_num)) {
                         logger->debug("Subgroup {}, can deliver a locally stable message: min_stable_num={} and least_undelivered_seq_num={}",
-                                      subgroup_num, min_stable_num, least_undelivered_rdmc_seq_num);
-                        RDMCMessage& msg = locally_stable_rdmc_messages[subgroup_num].begin()->second;
-                        deliver_message(msg, subgroup_num);
+                                      subgroup_num, min_stable_num, seq_num);
+                        deliver_message(*rdmc_msg, subgroup_num);
                         // DERECHO_LOG(-1, -1, "deliver_message() done");
-                        sst.delivered_num[member_index][subgroup_num] = least_undelivered_rdmc_seq_num;
-                        locally_stable_rdmc_messages[subgroup_num].erase(locally_stable_rdmc_messages[subgroup_num].begin());
+                        locally_stable_rdmc_messages[subgroup_num].erase(seq_num);
                         // DERECHO_LOG(-1, -1, "message_erase_done");
-                    } else if(least_undelivered_sst_seq_num < least_undelivered_rdmc_seq_num && least_undelivered_sst_seq_num <= min_stable_num) {
-                        update_sst = true;
+                    } else if(SSTMessage* sst_msg = locally_stable_sst_messages[subgroup_num].find(seq_num)) {
                         logger->debug("Subgroup {}, can deliver a locally stable message: min_stable_num={} and least_undelivered_seq_num={}",
-                                      subgroup_num, min_stable_num, least_undelivered_sst_seq_num);
-                        SSTMessage& msg = locally_stable_sst_messages[subgroup_num].begin()->second;
-                        deliver_message(msg, subgroup_num);
+                                      subgroup_num, min_stable_num, seq_num);
+                        deliver_message(*sst_msg, subgroup_num);
                         // DERECHO_LOG(-1, -1, "deliver_message() done");
-                        sst.delivered_num[member_index][subgroup_num] = least_undelivered_sst_seq_num;
-                        locally_stable_sst_messages[subgroup_num].erase(locally_stable_sst_messages[subgroup_num].begin());
+                        locally_stable_sst_messages[subgroup_num].erase(seq_num);
                         // DERECHO_LOG(-1, -1, "message_erase_done");
                     } else {
                         break;
                     }
+                    last_delivered = seq_num;
                 }
-                if(update_sst) {
+                // delivered_num is only advanced once the batch has been handed over,
+                // since a sender may reuse the space of messages it covers
+                flush_delivery_batch(subgroup_num);
+                if(last_delivered >= first_undelivered) {
+                    sst.delivered_num[member_index][subgroup_num] = last_delivered;
                     // DERECHO_LOG(-1, -1, "delivery_put_start");
-                    sst.put(get_shard_sst_indices(subgroup_num),
+                    sst.put(desc.shard_sst_indices,
                             (char*)std::addressof(sst.delivered_num[0][subgroup_num]) - sst.getBaseAddress(),
                             sizeof(long long int));
                     // DERECHO_LOG(-1, -1, "delivery_put_end");
                 }
             };
 
-            delivery_pred_handles.emplace_back(sst->predicates.insert(delivery_pred, delivery_trig, sst::PredicateType::RECURRENT));
-
-            int shard_sender_index;
-            std::tie(shard_senders, shard_sender_index) = subgroup_to_senders_and_sender_rank.at(subgroup_num);
-            num_shard_senders = get_num_senders(shard_senders);
-            if(shard_sender_index >= 0) {
-                auto sender_pred = [this, subgroup_num, shard_members, num_shard_members, shard_sender_index, num_shard_senders](const DerechoSST& sst) {
-                    long long int seq_num = next_message_to_deliver[subgroup_num] * num_shard_senders + shard_sender_index;
-                    for(uint i = 0; i < num_shard_members; ++i) {
-                        if(sst.delivered_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num] < seq_num
-                           || (file_writer && sst.persisted_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num] < seq_num)) {
-                            return false;
-                        }
-                    }
-                    return true;
+            delivery_pred_handles.emplace_back(sst->predicates.insert(delivery_pred, delivery_trig,
+                                                                      sst::PredicateType::RECURRENT,
+                                                                      {}, predicate_group));
+
+            if(desc.my_sender_rank >= 0) {
+                auto sender_pred = [this, subgroup_num, &desc](const DerechoSST& sst) {
+                    long long int seq_num = next_message_to_deliver[subgroup_num] * desc.num_senders() + desc.my_sender_rank;
+                    return sst::column_min((volatile char*)std::addressof(sst.delivered_num[0][subgroup_num]),
+                                           desc.shard_row_offsets) >= seq_num
+                           && (!file_writer
+                               || sst::column_min((volatile char*)std::addressof(sst.persisted_num[0][subgroup_num]),
+                                                  desc.shard_row_offsets) >= seq_num);
                 };
                 auto sender_trig = [this, subgroup_num](DerechoSST& sst) {
-                    sender_cv.notify_all();
+                    notify_sender_thread(subgroup_num);
                     next_message_to_deliver[subgroup_num]++;
+                    notify_send_space();
                 };
+                // the predicate only reads the shard's delivered_num and persisted_num
+                // for this subgroup, plus state that only its own trigger changes
+                std::vector<sst::predicate_input> sender_pred_inputs{
+                        {(char*)std::addressof(sst->delivered_num[0][subgroup_num]) - sst->getBaseAddress(),
+                         sizeof(long long int), desc.shard_sst_indices},
+                        {(char*)std::addressof(sst->persisted_num[0][subgroup_num]) - sst->getBaseAddress(),
+                         sizeof(long long int), desc.shard_sst_indices}};
                 sender_pred_handles.emplace_back(sst->predicates.insert(sender_pred, sender_trig,
-                                                                        sst::PredicateType::RECURRENT));
+                                                                        sst::PredicateType::RECURRENT,
+                                                                        sender_pred_inputs, predicate_group));
             }
         } else {
-            int shard_sender_index;
-            std::tie(shard_senders, shard_sender_index) = subgroup_to_senders_and_sender_rank.at(subgroup_num);
-            num_shard_senders = get_num_senders(shard_senders);
-            if(shard_sender_index >= 0) {
-                auto sender_pred = [this, subgroup_num, shard_members, num_shard_members, shard_sender_index, num_shard_senders](const DerechoSST& sst) {
-                    for(uint i = 0; i < num_shard_members; ++i) {
-                        auto num_received_offset = subgroup_to_num_received_offset.at(subgroup_num);
-                        if(sst.num_received[node_id_to_sst_index.at(shard_members[i])][num_received_offset + shard_sender_index]
-                           < (long long int)(future_message_indices[subgroup_num] - 1 - window_size)) {
-                            return false;
-                        }
-                    }
-                    return true;
+            if(desc.my_sender_rank >= 0) {
+                auto sender_pred = [this, subgroup_num, &desc](const DerechoSST& sst) {
+                    return sst::column_min((volatile char*)std::addressof(sst.num_received[0][desc.num_received_offset + desc.my_sender_rank]),
+                                           desc.shard_row_offsets)
+                           >= (long long int)(future_message_indices[subgroup_num] - 1 - window_size);
                 };
                 auto sender_trig = [this, subgroup_num](DerechoSST& sst) {
-                    sender_cv.notify_all();
+                    notify_sender_thread(subgroup_num);
+                    notify_send_space();
                 };
                 sender_pred_handles.emplace_back(sst->predicates.insert(sender_pred, sender_trig,
-                                                                        sst::PredicateType::RECURRENT));
+                                                                        sst::PredicateType::RECURRENT,
+                                                                        {}, predicate_group));
             }
         }
     }
@@ -931,12 +1326,107 @@ long long unsigned int MulticastGroup::compute_max_msg_size(
     return max_msg_size;
 }
 
+uint32_t MulticastGroup::compute_sst_max_msg_size(const DerechoParams& derecho_params) {
+    const uint32_t max_msg_size = std::min<long long unsigned int>(
+            compute_max_msg_size(derecho_params.max_payload_size, derecho_params.block_size),
+            sst::max_msg_size);
+    return derecho_params.sst_message_batching ? sst::batch_entry_len(max_msg_size) : max_msg_size;
+}
+
+std::vector<size_t> MulticastGroup::compute_buffer_class_sizes(long long unsigned int max_msg_size) {
+    // The smallest class is a page, so a buffer never shares one with another
+    std::vector<size_t> class_sizes;
+    size_t class_size = 4096;
+    while(class_size < max_msg_size) {
+        class_sizes.push_back(class_size);
+        class_size *= 2;
+    }
+    class_sizes.push_back(max_msg_size);
+    return class_sizes;
+}
+
+/**
+ * Delivered messages are read in place from the ring, and a sender can have
+ * at most window_size undelivered messages, so the ring holds window_size
+ * entries of the largest size: an entry is only overwritten once every
+ * message in it has been delivered.
+ */
+uint32_t MulticastGroup::compute_sst_ring_size(const DerechoParams& derecho_params) {
+    return sst::ring_size_for(derecho_params.window_size, compute_sst_max_msg_size(derecho_params));
+}
+
+/**
+ * Holding acknowledgements back lets a receiver write num_received and
+ * seq_num once for several messages, but also holds back stability, so they
+ * are never held for longer than sst_ack_timeout_us, nor once a sender has
+ * used up half its window waiting for them.
+ */
+bool MulticastGroup::sst_acks_due(const sst_ack_state& ack_state) const {
+    if(ack_state.num_unacked == 0) {
+        return ack_state.seq_num_changed;
+    }
+    if(ack_state.num_unacked >= sst_ack_batch_size
+       || steady_time_ns() - ack_state.oldest_unacked_ns >= (uint64_t)sst_ack_timeout_us * 1000) {
+        return true;
+    }
+    const uint32_t window_threshold = std::max(window_size / 2, 1u);
+    for(const auto num_unacked : ack_state.num_unacked_by_sender) {
+        if(num_unacked >= window_threshold) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MulticastGroup::send_sst_acks(subgroup_id_t subgroup_num) {
+    sst_ack_state& ack_state = sst_ack_states[subgroup_num];
+    sst->put((char*)std::addressof(sst->num_received_sst[0][ack_state.num_received_offset]) - sst->getBaseAddress(),
+             sizeof(sst->num_received_sst[0][0]) * ack_state.num_senders);
+    if(ack_state.seq_num_changed) {
+        sst->put((char*)std::addressof(sst->seq_num[0][subgroup_num]) - sst->getBaseAddress(),
+                 sizeof(long long int));
+    }
+    sst->put((char*)std::addressof(sst->num_received[0][ack_state.num_received_offset]) - sst->getBaseAddress(),
+             sizeof(long long int) * ack_state.num_senders);
+    ack_state.num_unacked = 0;
+    std::fill(ack_state.num_unacked_by_sender.begin(), ack_state.num_unacked_by_sender.end(), 0);
+    ack_state.seq_num_changed = false;
+    num_sst_acks_sent++;
+}
+
 void MulticastGroup::wedge() {
     bool thread_shutdown_existing = thread_shutdown.exchange(true);
     if(thread_shutdown_existing) {  // Wedge has already been called
         return;
     }
 
+    // Fail the sends still waiting for space, and wake the threads waiting for it
+    {
+        std::lock_guard<std::mutex> lock(async_sends_mtx);
+        for(auto& requests : async_sends) {
+            for(auto& request : requests) {
+                request.sent.set_value(false);
+            }
+            num_async_sends -= requests.size();
+            requests.clear();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(send_space_mtx);
+        send_space_generation++;
+    }
+    send_space_cv.notify_all();
+
+    // Send the batched messages still waiting for their batch to fill up; a
+    // message still being written is dropped, as its send() will now fail
+    if(sst_message_batching) {
+        for(auto& sst_multicast_group : sst_multicast_group_ptrs) {
+            if(sst_multicast_group) {
+                sst_multicast_group->close();
+            }
+        }
+    }
+
     //Consume and remove all the predicate handles
     for(auto handle_iter = sender_pred_handles.begin(); handle_iter != sender_pred_handles.end();) {
         sst->predicates.remove(*handle_iter);
@@ -946,6 +1436,16 @@ void MulticastGroup::wedge() {
         sst->predicates.remove(*handle_iter);
         handle_iter = receiver_pred_handles.erase(handle_iter);
     }
+    // Acknowledge whatever the receive predicates were still holding back
+    {
+        std::lock_guard<std::mutex> lock(msg_state_mtx);
+        for(const auto& p : subgroup_to_shard_and_rank) {
+            const sst_ack_state& ack_state = sst_ack_states[p.first];
+            if(ack_state.num_unacked > 0 || ack_state.seq_num_changed) {
+                send_sst_acks(p.first);
+            }
+        }
+    }
     for(auto handle_iter = stability_pred_handles.begin(); handle_iter != stability_pred_handles.end();) {
         sst->predicates.remove(*handle_iter);
         handle_iter = stability_pred_handles.erase(handle_iter);
@@ -959,14 +1459,56 @@ void MulticastGroup::wedge() {
         rdmc::destroy_group(i + rdmc_group_num_offset);
     }
 
-    sender_cv.notify_all();
-    if(sender_thread.joinable()) {
-        sender_thread.join();
+    for(auto& state : sender_threads) {
+        {
+            std::lock_guard<std::mutex> lock(state->mtx);
+            state->cv.notify_all();
+        }
+        if(state->thread.joinable()) {
+            state->thread.join();
+        }
+    }
+}
+
+/**
+ * Subgroups this node sends in are dealt out to the sender threads in turn,
+ * so that RDMC sends in different subgroups are issued concurrently, without
+ * contending on msg_state_mtx or on each other's locks.
+ */
+void MulticastGroup::initialize_sender_threads() {
+    subgroup_to_sender_thread.assign(total_num_subgroups, -1);
+    std::vector<subgroup_id_t> sending_subgroups;
+    for(const auto& p : subgroup_to_shard_and_rank) {
+        if(subgroup_descriptors[p.first].my_sender_rank >= 0) {
+            sending_subgroups.push_back(p.first);
+        }
+    }
+    const uint32_t num_threads = std::max<size_t>(std::min<size_t>(num_sender_threads, sending_subgroups.size()), 1);
+    for(uint32_t i = 0; i < num_threads; ++i) {
+        sender_threads.emplace_back(std::make_unique<sender_thread_state>());
+    }
+    for(uint32_t i = 0; i < sending_subgroups.size(); ++i) {
+        subgroup_to_sender_thread[sending_subgroups[i]] = i % num_threads;
+        sender_threads[i % num_threads]->subgroups.push_back(sending_subgroups[i]);
+    }
+}
+
+void MulticastGroup::start_sender_threads() {
+    for(auto& state : sender_threads) {
+        state->thread = std::thread(&MulticastGroup::send_loop, this, std::ref(*state));
     }
 }
 
-void MulticastGroup::send_loop() {
+void MulticastGroup::notify_sender_thread(subgroup_id_t subgroup_num) {
+    const int sender_thread_index = subgroup_to_sender_thread[subgroup_num];
+    if(sender_thread_index >= 0) {
+        sender_threads[sender_thread_index]->cv.notify_all();
+    }
+}
+
+void MulticastGroup::send_loop(sender_thread_state& state) {
     pthread_setname_np(pthread_self(), "sender_thread");
+    uint32_t next_to_check = 0;
     subgroup_id_t subgroup_to_send = 0;
     auto should_send_to_subgroup = [&](subgroup_id_t subgroup_num) {
         if(!rdmc_sst_groups_created) {
@@ -976,50 +1518,43 @@ void MulticastGroup::send_loop() {
             return false;
         }
         RDMCMessage& msg = pending_sends[subgroup_num].front();
-        uint32_t shard_num;
-        uint32_t shard_index;
-
-        std::tie(shard_num, shard_index) = subgroup_to_shard_and_rank.at(subgroup_num);
-        uint32_t num_shard_senders;
-        int shard_sender_index;
-        std::vector<int> shard_senders;
-        std::tie(shard_senders, shard_sender_index) = subgroup_to_senders_and_sender_rank.at(subgroup_num);
-        num_shard_senders = get_num_senders(shard_senders);
+        const SubgroupDescriptor& desc = subgroup_descriptors[subgroup_num];
+        const int shard_sender_index = desc.my_sender_rank;
         assert(shard_sender_index >= 0);
 
-        // std::cout << "num_received offset = " << subgroup_to_num_received_offset.at(subgroup_num) + shard_sender_index <<
-        //         ", num_received entry " <<  sst->num_received[member_index][subgroup_to_num_received_offset.at(subgroup_num) + shard_sender_index] <<
+        // std::cout << "num_received offset = " << desc.num_received_offset + shard_sender_index <<
+        //         ", num_received entry " <<  sst->num_received[member_index][desc.num_received_offset + shard_sender_index] <<
         //         ", message index = " << msg.index << std::endl;
-        if(sst->num_received[member_index][subgroup_to_num_received_offset.at(subgroup_num) + shard_sender_index] < msg.index - 1) {
+        if(sst->num_received[member_index][desc.num_received_offset + shard_sender_index] < msg.index - 1) {
             return false;
         }
 
-        std::vector<node_id_t> shard_members = subgroup_to_membership.at(subgroup_num);
-        auto num_shard_members = shard_members.size();
-        assert(num_shard_members >= 1);
-        if(subgroup_to_mode.at(subgroup_num) != Mode::RAW) {
-            for(uint i = 0; i < num_shard_members; ++i) {
-                if(sst->delivered_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num] < (long long int)((msg.index - window_size) * num_shard_senders + shard_sender_index)
-                   || (file_writer && sst->persisted_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num] < (long long int)((msg.index - window_size) * num_shard_senders + shard_sender_index))) {
-                    return false;
-                }
+        assert(desc.num_members() >= 1);
+        if(desc.mode != Mode::RAW) {
+            const long long int min_delivered = (msg.index - window_size) * desc.num_senders() + shard_sender_index;
+            if(sst::column_min((volatile char*)std::addressof(sst->delivered_num[0][subgroup_num]),
+                               desc.shard_row_offsets) < min_delivered
+               || (file_writer && sst::column_min((volatile char*)std::addressof(sst->persisted_num[0][subgroup_num]),
+                                                  desc.shard_row_offsets) < min_delivered)) {
+                return false;
             }
         } else {
-            for(uint i = 0; i < num_shard_members; ++i) {
-                auto num_received_offset = subgroup_to_num_received_offset.at(subgroup_num);
-                if(sst->num_received[node_id_to_sst_index.at(shard_members[i])][num_received_offset + shard_sender_index] < (long long int)(future_message_indices[subgroup_num] - 1 - window_size)) {
-                    return false;
-                }
+            if(sst::column_min((volatile char*)std::addressof(sst->num_received[0][desc.num_received_offset + shard_sender_index]),
+                               desc.shard_row_offsets)
+               < (long long int)(future_message_indices[subgroup_num] - 1 - window_size)) {
+                return false;
             }
         }
 
         return true;
     };
+    // round-robin over the thread's own subgroups only
     auto should_send = [&]() {
-        for(uint i = 1; i <= total_num_subgroups; ++i) {
-            auto subgroup_num = (subgroup_to_send + i) % total_num_subgroups;
+        for(uint i = 0; i < state.subgroups.size(); ++i) {
+            const subgroup_id_t subgroup_num = state.subgroups[(next_to_check + i) % state.subgroups.size()];
             if(should_send_to_subgroup(subgroup_num)) {
                 subgroup_to_send = subgroup_num;
+                next_to_check = (next_to_check + i + 1) % state.subgroups.size();
                 return true;
             }
         }
@@ -1027,9 +1562,9 @@ void MulticastGroup::send_loop() {
     };
     auto should_wake = [&]() { return thread_shutdown || should_send(); };
     try {
-        std::unique_lock<std::mutex> lock(msg_state_mtx);
+        std::unique_lock<std::mutex> lock(state.mtx);
         while(!thread_shutdown) {
-            sender_cv.wait(lock, should_wake);
+            state.cv.wait(lock, should_wake);
             // DERECHO_LOG(send_cnt, -1, "sender thread woke up");
             if(!thread_shutdown) {
                 current_sends[subgroup_to_send] = std::move(pending_sends[subgroup_to_send].front());
@@ -1037,7 +1572,8 @@ void MulticastGroup::send_loop() {
                 logger->debug("Calling send in subgroup {} on message {} from sender {}", subgroup_to_send, current_sends[subgroup_to_send]->index, current_sends[subgroup_to_send]->sender_id);
                 // DERECHO_LOG(-1, -1, "did_log_event");
                 if(!rdmc::send(subgroup_to_rdmc_group[subgroup_to_send],
-                               current_sends[subgroup_to_send]->message_buffer.mr, 0,
+                               current_sends[subgroup_to_send]->message_buffer.mr,
+                               current_sends[subgroup_to_send]->message_buffer.offset,
                                current_sends[subgroup_to_send]->size)) {
                     throw std::runtime_error("rdmc::send returned false");
                 }
@@ -1056,7 +1592,8 @@ void MulticastGroup::check_failures_loop() {
     while(!thread_shutdown) {
         std::this_thread::sleep_for(std::chrono::milliseconds(sender_timeout));
         if(sst) {
-            sst->put_with_completion((char*)std::addressof(sst->heartbeat[0]) - sst->getBaseAddress(), sizeof(bool));
+            // heartbeats are pipelined; a failed one freezes its row on a later heartbeat
+            sst->put_with_completion_async((char*)std::addressof(sst->heartbeat[0]) - sst->getBaseAddress(), sizeof(bool));
         }
     }
 
@@ -1086,30 +1623,22 @@ char* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
         return nullptr;
     }
 
-    uint32_t shard_num, shard_index;
-    std::tie(shard_num, shard_index) = subgroup_to_shard_and_rank.at(subgroup_num);
-    std::vector<node_id_t> shard_members = subgroup_to_membership.at(subgroup_num);
-    auto num_shard_members = shard_members.size();
+    const SubgroupDescriptor& desc = subgroup_descriptors[subgroup_num];
     // if the current node is not a sender, shard_sender_index will be -1
-    uint32_t num_shard_senders;
-    int shard_sender_index;
-    std::vector<int> shard_senders;
-    std::tie(shard_senders, shard_sender_index) = subgroup_to_senders_and_sender_rank.at(subgroup_num);
-    num_shard_senders = get_num_senders(shard_senders);
+    const int shard_sender_index = desc.my_sender_rank;
     assert(shard_sender_index >= 0);
 
-    if(subgroup_to_mode.at(subgroup_num) != Mode::RAW) {
-        for(uint i = 0; i < num_shard_members; ++i) {
-            if(sst->delivered_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num] < (long long int)((future_message_indices[subgroup_num] - window_size) * num_shard_senders + shard_sender_index)) {
-                return nullptr;
-            }
+    if(desc.mode != Mode::RAW) {
+        const long long int min_delivered = (future_message_indices[subgroup_num] - window_size) * desc.num_senders() + shard_sender_index;
+        if(sst::column_min((volatile char*)std::addressof(sst->delivered_num[0][subgroup_num]),
+                           desc.shard_row_offsets) < min_delivered) {
+            return nullptr;
         }
     } else {
-        for(uint i = 0; i < num_shard_members; ++i) {
-            auto num_received_offset = subgroup_to_num_received_offset.at(subgroup_num);
-            if(sst->num_received[node_id_to_sst_index.at(shard_members[i])][num_received_offset + shard_sender_index] < (long long int)(future_message_indices[subgroup_num] - window_size)) {
-                return nullptr;
-            }
+        if(sst::column_min((volatile char*)std::addressof(sst->num_received[0][desc.num_received_offset + shard_sender_index]),
+                           desc.shard_row_offsets)
+           < (long long int)(future_message_indices[subgroup_num] - window_size)) {
+            return nullptr;
         }
     }
 
@@ -1119,22 +1648,20 @@ char* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
 
     if(transfer_medium) {
         std::unique_lock<std::mutex> lock(msg_state_mtx);
-        if(free_message_buffers[subgroup_num].empty()) return nullptr;
-
         // Create new Message
         RDMCMessage msg;
+        if(!take_message_buffer(subgroup_num, msg_size, msg.message_buffer)) return nullptr;
         msg.sender_id = members[member_index];
         msg.index = future_message_indices[subgroup_num];
         msg.size = msg_size;
-        msg.message_buffer = std::move(free_message_buffers[subgroup_num].back());
-        free_message_buffers[subgroup_num].pop_back();
 
         // Fill header
-        char* buf = msg.message_buffer.buffer.get();
+        char* buf = msg.message_buffer.get();
         ((header*)buf)->header_size = sizeof(header);
         ((header*)buf)->pause_sending_turns = pause_sending_turns;
         ((header*)buf)->index = msg.index;
         ((header*)buf)->cooked_send = cooked_send;
+        ((header*)buf)->aggregated = false;
 
         next_sends[subgroup_num] = std::move(msg);
         future_message_indices[subgroup_num] += pause_sending_turns + 1;
@@ -1151,6 +1678,7 @@ char* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
         ((header*)buf)->pause_sending_turns = pause_sending_turns;
         ((header*)buf)->index = future_message_indices[subgroup_num];
         ((header*)buf)->cooked_send = cooked_send;
+        ((header*)buf)->aggregated = false;
         future_message_indices[subgroup_num] += pause_sending_turns + 1;
 
         last_transfer_medium[subgroup_num] = transfer_medium;
@@ -1164,11 +1692,20 @@ bool MulticastGroup::send(subgroup_id_t subgroup_num) {
         return false;
     }
     if(last_transfer_medium[subgroup_num]) {
-        std::lock_guard<std::mutex> lock(msg_state_mtx);
+        // packing messages takes and frees buffers, so needs msg_state_mtx,
+        // which must be locked before the sender thread's mutex
+        std::unique_lock<std::mutex> msg_state_lock(msg_state_mtx, std::defer_lock);
+        if(rdmc_send_aggregation_size) {
+            msg_state_lock.lock();
+        }
+        sender_thread_state& sender = *sender_threads[subgroup_to_sender_thread[subgroup_num]];
+        std::lock_guard<std::mutex> lock(sender.mtx);
         assert(next_sends[subgroup_num]);
-        pending_sends[subgroup_num].push(std::move(*next_sends[subgroup_num]));
+        if(!rdmc_send_aggregation_size || !aggregate_pending_send(subgroup_num, *next_sends[subgroup_num])) {
+            pending_sends[subgroup_num].push(std::move(*next_sends[subgroup_num]));
+        }
         next_sends[subgroup_num] = std::experimental::nullopt;
-        sender_cv.notify_all();
+        sender.cv.notify_all();
         // DERECHO_LOG(-1, -1, "user_send_finished");
         return true;
     } else {
@@ -1178,14 +1715,105 @@ bool MulticastGroup::send(subgroup_id_t subgroup_num) {
     }
 }
 
-std::vector<uint32_t> MulticastGroup::get_shard_sst_indices(subgroup_id_t subgroup_num) {
-    std::vector<node_id_t> shard_members = subgroup_to_membership.at(subgroup_num);
+char* MulticastGroup::get_sendbuffer_ptr_blocking(subgroup_id_t subgroup_num,
+                                                  long long unsigned int payload_size,
+                                                  bool transfer_medium, int pause_sending_turns,
+                                                  bool cooked_send, bool null_send) {
+    if(!rdmc_sst_groups_created || (!null_send && payload_size + sizeof(header) > max_msg_size)) {
+        return get_sendbuffer_ptr(subgroup_num, payload_size, transfer_medium, pause_sending_turns,
+                                  cooked_send, null_send);
+    }
+    num_send_space_waiters++;
+    char* buf;
+    while(true) {
+        // a window that moves after this read changes the generation, so
+        // its wake-up cannot be missed between the attempt and the wait
+        const uint64_t generation = send_space_generation;
+        buf = get_sendbuffer_ptr(subgroup_num, payload_size, transfer_medium, pause_sending_turns,
+                                 cooked_send, null_send);
+        if(buf || thread_shutdown) {
+            break;
+        }
+        std::unique_lock<std::mutex> lock(send_space_mtx);
+        send_space_cv.wait(lock, [&]() {
+            return send_space_generation != generation || thread_shutdown;
+        });
+    }
+    num_send_space_waiters--;
+    return buf;
+}
 
-    std::vector<uint32_t> shard_sst_indices;
-    for(auto m : shard_members) {
-        shard_sst_indices.push_back(node_id_to_sst_index.at(m));
+std::future<bool> MulticastGroup::send_async(subgroup_id_t subgroup_num, long long unsigned int payload_size,
+                                             const send_fill_callback& fill, bool transfer_medium,
+                                             int pause_sending_turns, bool cooked_send, bool null_send) {
+    async_send_request request{payload_size, transfer_medium, pause_sending_turns, cooked_send, null_send, fill, {}};
+    std::future<bool> sent = request.sent.get_future();
+    {
+        std::lock_guard<std::mutex> lock(async_sends_mtx);
+        if(thread_shutdown || !rdmc_sst_groups_created) {
+            request.sent.set_value(false);
+            return sent;
+        }
+        async_sends[subgroup_num].push_back(std::move(request));
+        num_async_sends++;
     }
-    return shard_sst_indices;
+    make_async_sends();
+    return sent;
+}
+
+void MulticastGroup::notify_send_space() {
+    if(num_send_space_waiters > 0) {
+        {
+            std::lock_guard<std::mutex> lock(send_space_mtx);
+            send_space_generation++;
+        }
+        send_space_cv.notify_all();
+    }
+    if(num_async_sends > 0) {
+        make_async_sends();
+    }
+}
+
+void MulticastGroup::make_async_sends() {
+    async_sends_changed = true;
+    // Whoever holds making_async_sends goes round again after letting go of
+    // it if async_sends_changed was set meanwhile, so no call goes unserved
+    while(async_sends_changed && !making_async_sends.exchange(true)) {
+        async_sends_changed = false;
+        for(subgroup_id_t subgroup_num = 0; subgroup_num < async_sends.size(); ++subgroup_num) {
+            while(true) {
+                std::unique_lock<std::mutex> lock(async_sends_mtx);
+                auto& requests = async_sends[subgroup_num];
+                if(requests.empty()) {
+                    break;
+                }
+                async_send_request& front = requests.front();
+                char* buf = get_sendbuffer_ptr(subgroup_num, front.payload_size, front.transfer_medium,
+                                               front.pause_sending_turns, front.cooked_send, front.null_send);
+                if(!buf) {
+                    break;
+                }
+                async_send_request request = std::move(front);
+                requests.pop_front();
+                num_async_sends--;
+                lock.unlock();
+                request.fill(buf);
+                request.sent.set_value(send(subgroup_num));
+            }
+        }
+        making_async_sends = false;
+    }
+}
+
+bool MulticastGroup::select_transfer_medium(subgroup_id_t subgroup_num, long long unsigned int payload_size) const {
+    // a payload size of 0 asks for a buffer of the largest size
+    return payload_size == 0 || payload_size > sst_send_thresholds[subgroup_num];
+}
+
+void MulticastGroup::set_sst_send_threshold(subgroup_id_t subgroup_num, long long unsigned int threshold) {
+    const long long unsigned int max_sst_payload_size
+            = std::min<long long unsigned int>(max_msg_size, sst::max_msg_size) - sizeof(header);
+    sst_send_thresholds[subgroup_num] = std::min(threshold, max_sst_payload_size);
 }
 
 void MulticastGroup::debug_print() {
@@ -1193,6 +1821,11 @@ void MulticastGroup::debug_print() {
     using std::endl;
     cout << "In DerechoGroup SST has " << sst->get_num_rows()
          << " rows; member_index is " << member_index << endl;
+    cout << "Remote writes saved by coalescing puts: " << sst->get_num_writes_saved() << endl;
+    cout << "SST evaluation thread wake-up latency:" << endl;
+    sst->get_wake_latency_histogram().print(cout);
+    cout << "SST evaluation thread CPU time per idle period:" << endl;
+    sst->get_idle_cpu_histogram().print(cout);
     uint num_received_offset = 0;
     cout << "Printing SST" << endl;
     for(uint subgroup_num = 0; subgroup_num < total_num_subgroups; ++subgroup_num) {
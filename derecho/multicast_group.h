@@ -1,9 +1,12 @@
 #pragma once
 
 #include <assert.h>
+#include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <experimental/optional>
 #include <functional>
+#include <future>
 #include <list>
 #include <map>
 #include <memory>
@@ -22,7 +25,10 @@
 #include "mutils-serialization/SerializationMacros.hpp"
 #include "mutils-serialization/SerializationSupport.hpp"
 #include "rdmc/rdmc.h"
+#include "received_index_window.h"
+#include "sequence_window.h"
 #include "spdlog/spdlog.h"
+#include "sst/column_min.h"
 #include "sst/multicast.h"
 #include "sst/sst.h"
 #include "subgroup_info.h"
@@ -37,6 +43,23 @@ using message_callback = std::function<void(subgroup_id_t, node_id_t, long long
 
 using rpc_handler_t = std::function<void(subgroup_id_t, node_id_t, char*, uint32_t)>;
 
+/** A message handed to a batch_message_callback. */
+struct delivered_message {
+    node_id_t sender_id;
+    long long int index;
+    char* data;
+    long long int size;
+};
+
+/** Alias for the type of std::function that receives a run of consecutive
+ * stable messages of a subgroup at once. The messages are only valid for the
+ * duration of the call. */
+using batch_message_callback = std::function<void(subgroup_id_t, const std::vector<delivered_message>&)>;
+
+/** Alias for the type of std::function that writes the payload of an
+ * asynchronous send into the buffer it is given. */
+using send_fill_callback = std::function<void(char*)>;
+
 /**
  * Bundles together a set of callback functions for message delivery events.
  * These will be invoked by DerechoGroup to hand control back to the client
@@ -45,6 +68,10 @@ using rpc_handler_t = std::function<void(subgroup_id_t, node_id_t, char*, uint32
 struct CallbackSet {
     message_callback global_stability_callback;
     message_callback local_persistence_callback = nullptr;
+    /** If set, the stable raw messages of ordered subgroups are handed to this
+     * callback, as many at once as became stable together, instead of to
+     * global_stability_callback. */
+    batch_message_callback global_stability_batch_callback = nullptr;
 };
 
 struct DerechoParams : public mutils::ByteRepresentable {
@@ -55,6 +82,45 @@ struct DerechoParams : public mutils::ByteRepresentable {
     unsigned int timeout_ms = 1;
     rdmc::send_algorithm type = rdmc::BINOMIAL_SEND;
     uint32_t rpc_port = derecho_rpc_port;
+    /** The number of threads evaluating SST predicates; each subgroup's
+     * predicates are always evaluated by the same thread. */
+    unsigned int num_predicate_threads = 1;
+    /** How the SST arranges the fields of each row; CACHE_LINE_BLOCKS keeps
+     * each subgroup's counters on their own cache lines. */
+    sst::RowLayout sst_row_layout = sst::RowLayout::DECLARATION_ORDER;
+    /** Whether the SST frames each row with sequence numbers, so that the
+     * leader's proposed changes are always read from a consistent copy.
+     * Each SST put then waits for the previous one's writes to complete, a
+     * round trip per put. */
+    bool sst_row_seqlock = false;
+    /** Whether small messages sent through the SST are packed several to a
+     * multicast slot, rather than taking one slot each. */
+    bool sst_message_batching = false;
+    /** How many SST messages a receiver takes in before it writes its
+     * acknowledgements (num_received and seq_num) back to the senders. */
+    unsigned int sst_ack_batch_size = 1;
+    /** The longest, in microseconds, a receiver holds back acknowledgements
+     * that sst_ack_batch_size has not triggered yet; 0 acknowledges every
+     * message as it is received. */
+    unsigned int sst_ack_timeout_us = 0;
+    /** The number of threads issuing RDMC sends; each sends the messages
+     * of its own share of the subgroups this node sends in. */
+    unsigned int num_sender_threads = 1;
+    /** Whether the arena holding the message buffers is backed by huge
+     * pages, when the system has them to spare. */
+    bool message_buffer_huge_pages = false;
+    /** Payloads of up to this many bytes whose transfer medium is chosen
+     * automatically, as RPC arguments are, go through the SST; larger ones
+     * go through RDMC. Each subgroup's threshold can be changed later. */
+    long long unsigned int sst_send_threshold = 1024;
+    /** Whether each node times SST writes to its shards at startup and sets
+     * the threshold of its subgroups from them, instead of using
+     * sst_send_threshold. */
+    bool calibrate_sst_send_threshold = false;
+    /** Small messages queued while an RDMC send of their subgroup is in
+     * progress are packed into one RDMC transfer of up to this many bytes;
+     * 0 sends every message on its own. */
+    long long unsigned int rdmc_send_aggregation_size = 0;
 
     DerechoParams(long long unsigned int max_payload_size,
                   long long unsigned int block_size,
@@ -62,17 +128,39 @@ struct DerechoParams : public mutils::ByteRepresentable {
                   unsigned int window_size = 3,
                   unsigned int timeout_ms = 1,
                   rdmc::send_algorithm type = rdmc::BINOMIAL_SEND,
-                  uint32_t rpc_port = derecho_rpc_port)
+                  uint32_t rpc_port = derecho_rpc_port,
+                  unsigned int num_predicate_threads = 1,
+                  sst::RowLayout sst_row_layout = sst::RowLayout::DECLARATION_ORDER,
+                  bool sst_row_seqlock = false,
+                  bool sst_message_batching = false,
+                  unsigned int sst_ack_batch_size = 1,
+                  unsigned int sst_ack_timeout_us = 0,
+                  unsigned int num_sender_threads = 1,
+                  bool message_buffer_huge_pages = false,
+                  long long unsigned int sst_send_threshold = 1024,
+                  bool calibrate_sst_send_threshold = false,
+                  long long unsigned int rdmc_send_aggregation_size = 0)
             : max_payload_size(max_payload_size),
               block_size(block_size),
               filename(filename),
               window_size(window_size),
               timeout_ms(timeout_ms),
               type(type),
-              rpc_port(rpc_port) {
+              rpc_port(rpc_port),
+              num_predicate_threads(num_predicate_threads),
+              sst_row_layout(sst_row_layout),
+              sst_row_seqlock(sst_row_seqlock),
+              sst_message_batching(sst_message_batching),
+              sst_ack_batch_size(sst_ack_batch_size),
+              sst_ack_timeout_us(sst_ack_timeout_us),
+              num_sender_threads(num_sender_threads),
+              message_buffer_huge_pages(message_buffer_huge_pages),
+              sst_send_threshold(sst_send_threshold),
+              calibrate_sst_send_threshold(calibrate_sst_send_threshold),
+              rdmc_send_aggregation_size(rdmc_send_aggregation_size) {
     }
 
-    DEFAULT_SERIALIZATION_SUPPORT(DerechoParams, max_payload_size, block_size, filename, window_size, timeout_ms, type, rpc_port);
+    DEFAULT_SERIALIZATION_SUPPORT(DerechoParams, max_payload_size, block_size, filename, window_size, timeout_ms, type, rpc_port, num_predicate_threads, sst_row_layout, sst_row_seqlock, sst_message_batching, sst_ack_batch_size, sst_ack_timeout_us, num_sender_threads, message_buffer_huge_pages, sst_send_threshold, calibrate_sst_send_threshold, rdmc_send_aggregation_size);
 };
 
 struct __attribute__((__packed__)) header {
@@ -80,25 +168,29 @@ struct __attribute__((__packed__)) header {
     uint32_t pause_sending_turns;
     uint32_t index;
     bool cooked_send;
+    /** Whether the message is an RDMC transfer holding several messages,
+     * each with its own header, packed after this header. Its index is that
+     * of the first message it holds. */
+    bool aggregated;
 };
 
 /**
- * Represents a block of memory used to store a message. This object contains
- * both the array of bytes in which the message is stored and the corresponding
- * RDMA memory region (which has registered that array of bytes as its buffer).
- * This is a move-only type, since memory regions can't be copied.
+ * Represents a block of memory used to store a message. Message buffers are
+ * slices of a larger arena that is registered as one RDMA memory region, so
+ * this object holds the arena's memory region, which keeps the arena alive,
+ * and the offset and size of the slice within it. This is a move-only type,
+ * since a slice must only be in use for one message at a time.
  */
 struct MessageBuffer {
-    std::unique_ptr<char[]> buffer;
     std::shared_ptr<rdma::memory_region> mr;
+    size_t offset = 0;
+    size_t size = 0;
 
     MessageBuffer() {}
-    MessageBuffer(size_t size) {
-        if(size != 0) {
-            buffer = std::unique_ptr<char[]>(new char[size]);
-            mr = std::make_shared<rdma::memory_region>(buffer.get(), size);
-        }
-    }
+    MessageBuffer(std::shared_ptr<rdma::memory_region> mr, size_t offset, size_t size)
+            : mr(std::move(mr)), offset(offset), size(size) {}
+    /** Returns the first byte of the slice. */
+    char* get() const { return mr ? mr->buffer + offset : nullptr; }
     MessageBuffer(const MessageBuffer&) = delete;
     MessageBuffer(MessageBuffer&&) = default;
     MessageBuffer& operator=(const MessageBuffer&) = delete;
@@ -127,6 +219,37 @@ struct SSTMessage {
     volatile char* buf;
 };
 
+/** What the predicates and the send path need to know about one of this
+ * node's subgroups in the current view, laid out flat so that it can be read
+ * without map lookups or copies. */
+struct SubgroupDescriptor {
+    Mode mode = Mode::ORDERED;
+    /** The index of the subgroup's first counter in num_received. */
+    uint32_t num_received_offset = 0;
+    /** This node's rank among the shard's senders, or -1 if it does not send. */
+    int my_sender_rank = -1;
+    /** The SST rows of the members of this node's shard, by shard rank. */
+    std::vector<uint32_t> shard_sst_indices;
+    /** The byte offsets of those rows from the SST's first row, for taking
+     * the minimum of a field over the shard with sst::column_min. */
+    std::vector<int64_t> shard_row_offsets;
+    /** The node IDs of the shard's senders, by sender rank. */
+    std::vector<node_id_t> sender_ids;
+    /** The SST rows of the shard's senders, by sender rank. */
+    std::vector<uint32_t> sender_sst_indices;
+
+    uint32_t num_members() const { return shard_sst_indices.size(); }
+    uint32_t num_senders() const { return sender_ids.size(); }
+    /** Returns the sender rank of the given node; it must be a sender. */
+    uint32_t sender_rank_of(node_id_t node_id) const {
+        uint32_t sender_rank = 0;
+        while(sender_rank < sender_ids.size() && sender_ids[sender_rank] != node_id) {
+            sender_rank++;
+        }
+        return sender_rank;
+    }
+};
+
 /** Implements the low-level mechanics of tracking multicasts in a Derecho group,
  * using RDMC to deliver messages and SST to track their arrival and stability.
  * This class should only be used as part of a Group, since it does not know how
@@ -153,6 +276,26 @@ public:  //consts can be public, right?
      *  Binomial pipeline by default. */
     const rdmc::send_algorithm type;
     const unsigned int window_size;
+    /** Whether messages sent through the SST are packed several to a ring entry. */
+    const bool sst_message_batching;
+    /** The largest entry in an SST multicast ring: a message, or a batch of them. */
+    const uint32_t sst_max_msg_size;
+    /** How many SST messages are received before acknowledging them. */
+    const unsigned int sst_ack_batch_size;
+    /** How long, in microseconds, acknowledgements may be held back. */
+    const unsigned int sst_ack_timeout_us;
+    /** The most threads issuing RDMC sends. */
+    const unsigned int num_sender_threads;
+    /** Whether message buffer arenas are backed by huge pages. */
+    const bool message_buffer_huge_pages;
+    /** The size of the message buffers of each size class, smallest first:
+     * powers of two, and max_msg_size for the largest. */
+    const std::vector<size_t> buffer_class_sizes;
+    /** The SST send threshold subgroups start with. */
+    const long long unsigned int sst_send_threshold;
+    /** The largest RDMC transfer small messages are packed into; 0 if they
+     * are not. */
+    const long long unsigned int rdmc_send_aggregation_size;
 
 private:
     /** Message-delivery event callbacks, supplied by the client, for "raw" sends */
@@ -165,8 +308,9 @@ private:
     /** Maps subgroup IDs (for subgroups this node is a member of) to the offset
      * of this node's num_received counter within that subgroup's SST section */
     const std::map<subgroup_id_t, uint32_t> subgroup_to_num_received_offset;
-    /** Used for synchronizing receives by RDMC and SST */
-    std::vector<std::list<long long int>> received_intervals;
+    /** Used for synchronizing receives by RDMC and SST: which message
+     * indices of each sender (by num_received entry) have arrived. */
+    std::vector<ReceivedIndexWindow> received_intervals;
     /** Maps subgroup IDs (for subgroups this node is a member of) to the members
      * of this node's shard of that subgroup */
     const std::map<subgroup_id_t, std::vector<node_id_t>> subgroup_to_membership;
@@ -180,9 +324,22 @@ private:
     uint16_t rdmc_group_num_offset;
     /** false if RDMC groups haven't been created successfully */
     bool rdmc_sst_groups_created = false;
-    /** Stores message buffers not currently in use. Protected by
-     * msg_state_mtx */
-    std::map<uint32_t, std::vector<MessageBuffer>> free_message_buffers;
+    /** The message buffers of one subgroup, by size class. A class holds
+     * at most window_size buffers per shard member, in use or not, and only
+     * grows when a message needs one of its buffers. */
+    struct message_buffer_pool {
+        /** The buffers of each class not currently in use. */
+        std::vector<std::vector<MessageBuffer>> free_buffers;
+        /** The number of buffers of each class, in use or not. */
+        std::vector<size_t> num_buffers;
+    };
+    /** Maps subgroup IDs (for subgroups this node is a member of) to their
+     * message buffers. Protected by msg_state_mtx */
+    std::map<subgroup_id_t, message_buffer_pool> message_buffer_pools;
+    /** Free message buffers, by size class, that no subgroup counts as its
+     * own, such as those of subgroups this node has left. They are handed
+     * out before new buffers are allocated. Protected by msg_state_mtx */
+    std::vector<std::vector<MessageBuffer>> spare_message_buffers;
 
     /** Index to be used the next time get_sendbuffer_ptr is called.
      * When next_message is not none, then next_message.index = future_message_index-1 */
@@ -191,35 +348,53 @@ private:
     /** next_message is the message that will be sent when send is called the next time.
      * It is boost::none when there is no message to send. */
     std::vector<std::experimental::optional<RDMCMessage>> next_sends;
-    /** Messages that are ready to be sent, but must wait until the current send finishes. */
+    /** Messages that are ready to be sent, but must wait until the current send finishes.
+     * Protected by the mutex of the subgroup's sender thread. */
     std::vector<std::queue<RDMCMessage>> pending_sends;
-    /** Vector of messages that are currently being sent out using RDMC, or boost::none otherwise. */
-    /** one per subgroup */
+    /** Vector of messages that are currently being sent out using RDMC, or boost::none otherwise.
+     * One per subgroup, protected by the mutex of the subgroup's sender thread. */
     std::vector<std::experimental::optional<RDMCMessage>> current_sends;
 
-    /** Messages that are currently being received. */
-    std::map<std::pair<uint32_t, long long int>, RDMCMessage> current_receives;
+    /** Messages that are currently being received, by subgroup and sequence number. */
+    std::vector<SequenceWindow<RDMCMessage>> current_receives;
 
     /** Messages that have finished sending/receiving but aren't yet globally stable */
-    std::map<uint32_t, std::map<long long int, RDMCMessage>> locally_stable_rdmc_messages;
-    /** Parallel map for SST messages */
-    std::map<uint32_t, std::map<long long int, SSTMessage>> locally_stable_sst_messages;
+    std::vector<SequenceWindow<RDMCMessage>> locally_stable_rdmc_messages;
+    /** Parallel windows for SST messages */
+    std::vector<SequenceWindow<SSTMessage>> locally_stable_sst_messages;
     /** Messages that are currently being written to persistent storage */
-    std::map<uint32_t, std::map<long long int, RDMCMessage>> non_persistent_messages;
+    std::vector<SequenceWindow<RDMCMessage>> non_persistent_messages;
     /** Messages that are currently being written to persistent storage */
-    std::map<uint32_t, std::map<long long int, SSTMessage>> non_persistent_sst_messages;
+    std::vector<SequenceWindow<SSTMessage>> non_persistent_sst_messages;
 
     std::vector<long long int> next_message_to_deliver;
+    /** Stable messages of the subgroup being delivered, waiting to be handed
+     * to the batch callback. Protected by msg_state_mtx */
+    std::vector<delivered_message> delivery_batch;
+    /** The RDMC buffers holding messages in delivery_batch, returned to
+     * their pools once the batch has been handed over. Protected by msg_state_mtx */
+    std::vector<MessageBuffer> delivery_batch_buffers;
     std::mutex msg_state_mtx;
-    std::condition_variable sender_cv;
 
     /** The time, in milliseconds, that a sender can wait to send a message before it is considered failed. */
     unsigned int sender_timeout;
 
     /** Indicates that the group is being destroyed. */
     std::atomic<bool> thread_shutdown{false};
-    /** The background thread that sends messages with RDMC. */
-    std::thread sender_thread;
+    /** A background thread that sends messages with RDMC, for the
+     * subgroups it owns. Its mutex protects those subgroups' pending_sends
+     * and current_sends; it may be locked while holding msg_state_mtx, but
+     * not the other way around. */
+    struct sender_thread_state {
+        std::vector<subgroup_id_t> subgroups;
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::thread thread;
+    };
+    std::vector<std::unique_ptr<sender_thread_state>> sender_threads;
+    /** For each subgroup, the index of the sender thread that owns it, or
+     * -1 if this node does not send in it. */
+    std::vector<int> subgroup_to_sender_thread;
 
     std::thread timeout_thread;
 
@@ -228,6 +403,34 @@ private:
 
     /** The SSTs for multicasts **/
     std::vector<std::unique_ptr<sst::multicast_group<DerechoSST>>> sst_multicast_group_ptrs;
+    /** For each subgroup, how far this node has read each sender's SST multicast ring. */
+    std::vector<std::vector<sst::ring_reader>> sst_ring_readers;
+
+    /** The SST multicast messages of a subgroup that this node has received
+     * but not yet acknowledged to their senders. */
+    struct sst_ack_state {
+        uint32_t num_received_offset = 0;
+        uint32_t num_senders = 0;
+        /** Unacknowledged messages from each sender. */
+        std::vector<uint32_t> num_unacked_by_sender;
+        /** Unacknowledged messages from all senders. */
+        uint32_t num_unacked = 0;
+        /** When the oldest unacknowledged message was received, in steady_clock nanoseconds. */
+        uint64_t oldest_unacked_ns = 0;
+        /** Whether seq_num has advanced since it was last written out. */
+        bool seq_num_changed = false;
+    };
+    /** For each subgroup, its unacknowledged SST messages; only touched by
+     * the subgroup's predicate thread, or with msg_state_mtx held. */
+    std::vector<sst_ack_state> sst_ack_states;
+    /** The number of times this node has written out its acknowledgements of SST messages. */
+    std::atomic<uint64_t> num_sst_acks_sent{0};
+    /** The number of SST multicast messages this node has delivered. */
+    std::atomic<uint64_t> num_sst_messages_delivered{0};
+
+    /** For each subgroup this node belongs to, indexed by subgroup ID, its
+     * shard's layout in this view; built once by the constructor. */
+    std::vector<SubgroupDescriptor> subgroup_descriptors;
 
     using pred_handle = typename sst::Predicates<DerechoSST>::pred_handle;
     std::list<pred_handle> receiver_pred_handles;
@@ -236,12 +439,57 @@ private:
     std::list<pred_handle> sender_pred_handles;
 
     std::vector<bool> last_transfer_medium;
+    /** The largest payload, in bytes, each subgroup sends through the SST
+     * when the transfer medium is chosen automatically. */
+    std::vector<std::atomic<long long unsigned int>> sst_send_thresholds;
+
+    /** A send queued by send_async, with the arguments of its
+     * get_sendbuffer_ptr call. */
+    struct async_send_request {
+        long long unsigned int payload_size;
+        bool transfer_medium;
+        int pause_sending_turns;
+        bool cooked_send;
+        bool null_send;
+        send_fill_callback fill;
+        std::promise<bool> sent;
+    };
+    /** The sends of each subgroup waiting for buffer space, in the order
+     * they were queued. Protected by async_sends_mtx */
+    std::vector<std::deque<async_send_request>> async_sends;
+    std::mutex async_sends_mtx;
+    /** The number of sends waiting in async_sends. */
+    std::atomic<uint32_t> num_async_sends{0};
+    /** Set by the one thread making queued sends at a time. */
+    std::atomic<bool> making_async_sends{false};
+    /** Set when there may be queued sends that the thread making them has
+     * not tried yet. */
+    std::atomic<bool> async_sends_changed{false};
+    /** Threads blocked in get_sendbuffer_ptr_blocking wait on send_space_cv
+     * for send_space_generation to change, which it does whenever a sender
+     * predicate finds that a window has moved. */
+    std::mutex send_space_mtx;
+    std::condition_variable send_space_cv;
+    std::atomic<uint64_t> send_space_generation{0};
+    std::atomic<uint32_t> num_send_space_waiters{0};
 
     std::unique_ptr<FileWriter> file_writer;
 
-    /** Continuously waits for a new pending send, then sends it. This function
-     * implements the sender thread. */
-    void send_loop();
+    /** Continuously waits for a new pending send in one of the thread's
+     * subgroups, then sends it. This function implements a sender thread. */
+    void send_loop(sender_thread_state& state);
+    /** Assigns the subgroups this node sends in to sender threads. */
+    void initialize_sender_threads();
+    /** Starts the sender threads. */
+    void start_sender_threads();
+    /** Wakes the sender thread of a subgroup, if it has one. */
+    void notify_sender_thread(subgroup_id_t subgroup_num);
+    /** Wakes the threads waiting for send buffer space, and makes the
+     * queued sends there is now space for. */
+    void notify_send_space();
+    /** Makes queued sends, in order, until one finds no buffer space; if
+     * another thread is already making them, leaves them to that thread. */
+    void make_async_sends();
 
     /** Checks for failures when a sender reaches its timeout. This function
      * implements the timeout thread. */
@@ -250,10 +498,66 @@ private:
     std::function<void(persistence::message)> make_file_written_callback();
     bool create_rdmc_sst_groups();
     void initialize_sst_row();
+    /** Builds the descriptor of each subgroup this node belongs to. */
+    void initialize_subgroup_descriptors();
+    /** Sizes the message windows of each subgroup this node belongs to. */
+    void initialize_message_windows();
+    /** Sets the SST send threshold of each subgroup this node sends in by
+     * comparing the time SST writes of increasing size take to reach the
+     * shard with an estimate, from the same timings, of an RDMC send. */
+    void calibrate_sst_send_thresholds();
+    /** Creates the message buffer pool of each subgroup this node belongs
+     * to that does not have one yet, stocking its smallest size class with
+     * spare buffers or, failing that, buffers sliced out of one new arena. */
+    void initialize_message_buffers();
+    /** Allocates and registers an arena of num_buffers message buffers of
+     * buffer_size bytes each. */
+    std::vector<MessageBuffer> allocate_message_buffers(size_t num_buffers, size_t buffer_size);
+    /** Returns the smallest size class whose buffers hold size bytes. */
+    uint32_t buffer_class_of(size_t size) const;
+    /** Takes a free buffer of at least size bytes from a subgroup's pool,
+     * growing the pool if needed, and returns whether there was one. Must
+     * be called with msg_state_mtx held. */
+    bool take_message_buffer(subgroup_id_t subgroup_num, size_t size, MessageBuffer& buffer);
+    /** Like take_message_buffer, for a message that has already arrived and
+     * must be stored: if every class that fits it is at its cap, the
+     * message's class grows past the cap instead of failing. Must be called
+     * with msg_state_mtx held. */
+    MessageBuffer take_receive_buffer(subgroup_id_t subgroup_num, size_t size);
+    /** Returns a buffer to the pool of the subgroup it was used in, or to
+     * the spare buffers if this node is not in that subgroup. Must be called
+     * with msg_state_mtx held. */
+    void release_message_buffer(subgroup_id_t subgroup_num, MessageBuffer&& buffer);
     void register_predicates();
 
+    /** Packs msg, if it is small enough, together with the last message
+     * queued in pending_sends, and returns whether it did. Must be called
+     * with msg_state_mtx and the subgroup's sender thread mutex held. */
+    bool aggregate_pending_send(subgroup_id_t subgroup_num, RDMCMessage& msg);
+    /** Copies the messages packed in a received aggregate into buffers of
+     * their own, makes them locally stable, and frees the aggregate's
+     * buffer. Returns the last index the aggregate accounts for, including
+     * the turns its messages skip. Must be called with msg_state_mtx held. */
+    long long int unpack_aggregated_message(subgroup_id_t subgroup_num, uint32_t sender_rank,
+                                            uint32_t num_shard_senders, RDMCMessage&& aggregate);
+
     void deliver_message(RDMCMessage& msg, uint32_t subgroup_num);
     void deliver_message(SSTMessage& msg, uint32_t subgroup_num);
+    /** Hands a stable raw message to the client: to the batch callback, by
+     * way of delivery_batch, if there is one, or else directly. */
+    void stability_upcall(subgroup_id_t subgroup_num, node_id_t sender_id, long long int index,
+                          char* data, long long int size);
+    /** Hands the messages in delivery_batch to the batch callback, then
+     * releases the buffers they were in. */
+    void flush_delivery_batch(subgroup_id_t subgroup_num);
+
+    /** Returns whether a subgroup's unacknowledged SST messages should be
+     * acknowledged now: enough of them have arrived, the oldest has waited
+     * long enough, or a sender's window is half used up. */
+    bool sst_acks_due(const sst_ack_state& ack_state) const;
+    /** Writes this node's num_received_sst, seq_num and num_received for a
+     * subgroup out to the other members. */
+    void send_sst_acks(subgroup_id_t subgroup_num);
 
     uint32_t get_num_senders(std::vector<int> shard_senders) {
         uint32_t num = 0;
@@ -266,42 +570,7 @@ private:
     };
 
     long long int resolve_num_received(long long beg_index, long long end_index, uint32_t num_received_entry) {
-        // std::cout << "num_received_entry = " << num_received_entry << std::endl;
-        // std::cout << "beg_index = " << beg_index << std::endl;
-        // std::cout << "end_index = " << end_index << std::endl;
-        auto it = received_intervals[num_received_entry].end();
-        it--;
-        while(*it > beg_index) {
-            it--;
-        }
-        if(std::next(it) == received_intervals[num_received_entry].end()) {
-            if(*it == beg_index - 1) {
-                *it = end_index;
-            } else {
-                received_intervals[num_received_entry].push_back(beg_index);
-                received_intervals[num_received_entry].push_back(end_index);
-            }
-        } else {
-            auto next_it = std::next(it);
-            if(*it != beg_index - 1) {
-                received_intervals[num_received_entry].insert(next_it, beg_index);
-                if(*next_it != end_index + 1) {
-                    received_intervals[num_received_entry].insert(next_it, end_index);
-                } else {
-                    received_intervals[num_received_entry].erase(next_it);
-                }
-            } else {
-                if(*next_it != end_index + 1) {
-                    received_intervals[num_received_entry].insert(next_it, end_index);
-                } else {
-                    received_intervals[num_received_entry].erase(next_it);
-                }
-                received_intervals[num_received_entry].erase(it);
-            }
-        }
-        // std::cout << "Returned value: "
-        //           << *std::next(received_intervals[num_received_entry].begin()) << std::endl;
-        return *std::next(received_intervals[num_received_entry].begin());
+        return received_intervals[num_received_entry].receive(beg_index, end_index);
     }
 
 public:
@@ -348,6 +617,37 @@ public:
      * This still allows making multiple send calls without acknowledgement; at a single point in time, however,
      * there is only one message per sender in the RDMC pipeline */
     bool send(subgroup_id_t subgroup_num);
+    /** Like get_sendbuffer_ptr, but waits without spinning until there is
+     * buffer space for the message instead of returning nullptr. Returns
+     * nullptr only if the message can never be sent in this group: it is too
+     * large, or the group could not be created or has been wedged. */
+    char* get_sendbuffer_ptr_blocking(subgroup_id_t subgroup_num, long long unsigned int payload_size,
+                                      bool transfer_medium = true, int pause_sending_turns = 0,
+                                      bool cooked_send = false, bool null_send = false);
+    /**
+     * Queues a message to be sent as soon as there is buffer space for it,
+     * and returns at once. When there is, fill is called with the buffer to
+     * write the payload into, and the message is then sent; fill runs on
+     * whichever thread found the space, often the SST predicate thread, so it
+     * should be quick. Queued sends of a subgroup are made in order, and must
+     * not be mixed with get_sendbuffer_ptr/send pairs on other threads.
+     * @return A future set to true once the message has been sent, or to
+     * false if the group is wedged first.
+     */
+    std::future<bool> send_async(subgroup_id_t subgroup_num, long long unsigned int payload_size,
+                                 const send_fill_callback& fill, bool transfer_medium = true,
+                                 int pause_sending_turns = 0, bool cooked_send = false,
+                                 bool null_send = false);
+    /** Returns whether the group has been wedged, so no longer sends. */
+    bool is_wedged() const { return thread_shutdown; }
+    /** Returns the transfer medium to pass to get_sendbuffer_ptr for a
+     * payload of payload_size bytes: false, for the SST, if it is no larger
+     * than the subgroup's SST send threshold, and true, for RDMC, if it is. */
+    bool select_transfer_medium(subgroup_id_t subgroup_num, long long unsigned int payload_size) const;
+    /** Sets the largest payload a subgroup sends through the SST when the
+     * transfer medium is chosen automatically; it is capped at the largest
+     * payload an SST message can hold. */
+    void set_sst_send_threshold(subgroup_id_t subgroup_num, long long unsigned int threshold);
 
     /** Stops all sending and receiving in this group, in preparation for shutting it down. */
     void wedge();
@@ -356,6 +656,13 @@ public:
     static long long unsigned int compute_max_msg_size(
             const long long unsigned int max_payload_size,
             const long long unsigned int block_size);
+    /** Returns the largest entry in an SST multicast ring: the largest
+     * message that can be sent through the SST, or a batch of them. */
+    static uint32_t compute_sst_max_msg_size(const DerechoParams& derecho_params);
+    /** Returns the sizes of the message buffer size classes. */
+    static std::vector<size_t> compute_buffer_class_sizes(long long unsigned int max_msg_size);
+    /** Returns the size of each subgroup's SST multicast ring, in bytes. */
+    static uint32_t compute_sst_ring_size(const DerechoParams& derecho_params);
     /** Maps subgroup IDs (for subgroups this node is a member of) to the pair
      * (this node's shard number, this node's shard rank)*/
     const std::map<subgroup_id_t, std::pair<uint32_t, uint32_t>>& get_subgroup_to_shard_and_rank() {
@@ -364,6 +671,14 @@ public:
     const std::map<subgroup_id_t, uint32_t>& get_subgroup_to_num_received_offset() {
         return subgroup_to_num_received_offset;
     }
-    std::vector<uint32_t> get_shard_sst_indices(uint32_t subgroup_num);
+    const std::vector<uint32_t>& get_shard_sst_indices(uint32_t subgroup_num) const {
+        return subgroup_descriptors[subgroup_num].shard_sst_indices;
+    }
+    /** Returns the number of times this node has acknowledged SST messages,
+     * and the number of SST messages it has delivered; their ratio shows how
+     * well acknowledgements are being coalesced. */
+    std::pair<uint64_t, uint64_t> get_sst_ack_counters() const {
+        return {num_sst_acks_sent, num_sst_messages_delivered};
+    }
 };
 }  // namespace derecho
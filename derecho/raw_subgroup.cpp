@@ -16,6 +16,38 @@ char* RawSubgroup::get_sendbuffer_ptr(unsigned long long int payload_size, bool
     }
 }
 
+char* RawSubgroup::get_sendbuffer_ptr_blocking(unsigned long long int payload_size, bool transfer_medium, int pause_sending_turns, bool null_send) {
+    if(is_valid()) {
+        return group_view_manager.get_sendbuffer_ptr_blocking(subgroup_id, payload_size, transfer_medium, pause_sending_turns, false, null_send);
+    } else {
+        throw derecho::empty_reference_exception{"Attempted to use an empty RawSubgroup"};
+    }
+}
+
+std::future<bool> RawSubgroup::send_async(unsigned long long int payload_size, const send_fill_callback& fill, bool transfer_medium, int pause_sending_turns, bool null_send) {
+    if(is_valid()) {
+        return group_view_manager.send_async(subgroup_id, payload_size, fill, transfer_medium, pause_sending_turns, false, null_send);
+    } else {
+        throw derecho::empty_reference_exception{"Attempted to use an empty RawSubgroup"};
+    }
+}
+
+bool RawSubgroup::select_transfer_medium(unsigned long long int payload_size) {
+    if(is_valid()) {
+        return group_view_manager.select_transfer_medium(subgroup_id, payload_size);
+    } else {
+        throw derecho::empty_reference_exception{"Attempted to use an empty RawSubgroup"};
+    }
+}
+
+void RawSubgroup::set_sst_send_threshold(unsigned long long int threshold) {
+    if(is_valid()) {
+        group_view_manager.set_sst_send_threshold(subgroup_id, threshold);
+    } else {
+        throw derecho::empty_reference_exception{"Attempted to use an empty RawSubgroup"};
+    }
+}
+
 void RawSubgroup::send() {
     if(is_valid()) {
         group_view_manager.send(subgroup_id);
@@ -48,6 +48,41 @@ public:
      */
     char* get_sendbuffer_ptr(unsigned long long int payload_size, bool transfer_medium = true, int pause_sending_turns = 0, bool null_send = false);
 
+    /**
+     * Gets a pointer into the send buffer for multicasts to this subgroup,
+     * waiting without spinning until there is space for the message.
+     * @param payload_size The size of the payload that the caller intends to
+     * send, in bytes.
+     * @return The buffer to write the payload into, or nullptr if the payload
+     * is too large to ever be sent.
+     */
+    char* get_sendbuffer_ptr_blocking(unsigned long long int payload_size, bool transfer_medium = true, int pause_sending_turns = 0, bool null_send = false);
+
+    /**
+     * Queues a multicast to this subgroup, to be sent once there is space in
+     * the send buffer, and returns at once.
+     * @param payload_size The size of the payload, in bytes.
+     * @param fill Called with the buffer to write the payload into, just
+     * before the message is sent; it may run on a Derecho thread.
+     * @return A future set to true once the message is sent, or to false if
+     * the view changes first.
+     */
+    std::future<bool> send_async(unsigned long long int payload_size, const send_fill_callback& fill, bool transfer_medium = true, int pause_sending_turns = 0, bool null_send = false);
+
+    /**
+     * Chooses the transfer medium for a payload: the SST for payloads up to
+     * this subgroup's SST send threshold, and RDMC for larger ones.
+     * @param payload_size The size of the payload, in bytes.
+     * @return The transfer_medium argument to pass to get_sendbuffer_ptr.
+     */
+    bool select_transfer_medium(unsigned long long int payload_size);
+
+    /**
+     * Sets the largest payload, in bytes, that select_transfer_medium sends
+     * through the SST in this subgroup.
+     */
+    void set_sst_send_threshold(unsigned long long int threshold);
+
     /**
      * Submits the contents of the send buffer to be sent on the next ordered
      * multicast to the subgroup.
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace derecho {
+
+/**
+ * Tracks which message indices of one sender have been received, when they
+ * can arrive out of order, and the longest prefix of indices that have all
+ * been received. Indices past the prefix are kept as bits in a circular
+ * bitmap, indexed by index modulo its size, so recording a receipt and
+ * advancing the prefix touch a few words and never allocate; the prefix
+ * moves a word at a time, counting the received indices with a bit scan.
+ * The bitmap doubles in size if an index lands further past the prefix
+ * than it can hold, as the placeholder indices of skipped turns may.
+ */
+class ReceivedIndexWindow {
+    static const uint32_t bits_per_word = 64;
+    std::vector<uint64_t> words;
+    /** Every index up to and including this one has been received. */
+    long long int prefix_end = -1;
+    /** No index received past the prefix is higher. */
+    long long int highest = -1;
+
+    uint64_t capacity() const { return words.size() * bits_per_word; }
+
+    uint64_t& word(long long int index) {
+        return words[(index / bits_per_word) % words.size()];
+    }
+
+    void set_bits(long long int beg_index, long long int end_index) {
+        while(beg_index <= end_index) {
+            const uint32_t bit = beg_index % bits_per_word;
+            const uint32_t num_bits = std::min<long long int>(bits_per_word - bit, end_index - beg_index + 1);
+            const uint64_t mask = num_bits == bits_per_word ? ~0ull : ((1ull << num_bits) - 1) << bit;
+            word(beg_index) |= mask;
+            beg_index += num_bits;
+        }
+    }
+
+    void grow(long long int end_index) {
+        size_t num_words = words.size();
+        while((uint64_t)(end_index - prefix_end) > num_words * bits_per_word) {
+            num_words *= 2;
+        }
+        std::vector<uint64_t> old_words(num_words, 0);
+        old_words.swap(words);
+        for(long long int index = prefix_end + 1; index <= highest; ++index) {
+            if(old_words[(index / bits_per_word) % old_words.size()] & (1ull << (index % bits_per_word))) {
+                set_bits(index, index);
+            }
+        }
+    }
+
+public:
+    /** Creates a window that holds capacity indices past the prefix before growing. */
+    explicit ReceivedIndexWindow(uint64_t capacity = bits_per_word)
+            : words(std::max<uint64_t>((capacity + bits_per_word - 1) / bits_per_word, 1), 0) {}
+
+    /** Records that the indices from beg_index to end_index, inclusive, have
+     * been received, and returns the last index of the received prefix. */
+    long long int receive(long long int beg_index, long long int end_index) {
+        beg_index = std::max(beg_index, prefix_end + 1);
+        if(beg_index > end_index) {
+            return prefix_end;
+        }
+        if((uint64_t)(end_index - prefix_end) > capacity()) {
+            grow(end_index);
+        }
+        set_bits(beg_index, end_index);
+        highest = std::max(highest, end_index);
+        // consume the run of received indices after the prefix, clearing their bits for reuse
+        while(true) {
+            const long long int next = prefix_end + 1;
+            const uint32_t bit = next % bits_per_word;
+            uint64_t& w = word(next);
+            const uint64_t pending = w >> bit;
+            const uint32_t run = ~pending ? __builtin_ctzll(~pending) : bits_per_word;
+            if(run == 0) {
+                break;
+            }
+            w &= run == bits_per_word ? 0 : ~(((1ull << run) - 1) << bit);
+            prefix_end += run;
+            if(bit + run < bits_per_word) {
+                break;
+            }
+        }
+        return prefix_end;
+    }
+
+    /** Returns the last index of the received prefix. */
+    long long int received_prefix_end() const { return prefix_end; }
+};
+}  // namespace derecho
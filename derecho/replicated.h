@@ -63,18 +63,33 @@ private:
     auto ordered_send_or_query(const std::vector<node_id_t>& destination_nodes,
                                Args&&... args) {
         if(is_valid()) {
-            char* buffer;
-            while(!(buffer = group_rpc_manager.view_manager.get_sendbuffer_ptr(subgroup_id, 0, true, 0, true))) {
-            };
-            std::shared_lock<std::shared_timed_mutex> view_read_lock(group_rpc_manager.view_manager.view_mutex);
-
-            std::size_t max_payload_size;
-            int buffer_offset = group_rpc_manager.populate_nodelist_header(destination_nodes,
-                                                                           buffer, max_payload_size);
-            buffer += buffer_offset;
+            // The send buffer is only requested once the size of the
+            // serialized arguments is known, so that small calls can be
+            // sent through the SST
+            std::shared_lock<std::shared_timed_mutex> view_read_lock(group_rpc_manager.view_manager.view_mutex,
+                                                                     std::defer_lock);
             std::cout << "Replicated: doing ordered send/query for function tagged " << tag << " in subgroup " << subgroup_id << std::endl;
             auto send_return_struct = wrapped_this->template send<tag>(
-                    [&buffer, &max_payload_size](size_t size) -> char* {
+                    [this, &destination_nodes, &view_read_lock](size_t size) -> char* {
+                        const std::size_t payload_size = sizeof(std::size_t)
+                                                         + destination_nodes.size() * sizeof(node_id_t) + size;
+                        const DerechoParams& params = group_rpc_manager.view_manager.derecho_params;
+                        // a call too large for any message could never get a buffer
+                        if(payload_size + sizeof(header)
+                           > MulticastGroup::compute_max_msg_size(params.max_payload_size, params.block_size)) {
+                            return nullptr;
+                        }
+                        const bool transfer_medium = group_rpc_manager.view_manager.select_transfer_medium(subgroup_id, payload_size);
+                        char* buffer;
+                        while(!(buffer = group_rpc_manager.view_manager.get_sendbuffer_ptr_blocking(
+                                        subgroup_id, payload_size, transfer_medium, 0, true))) {
+                        };
+                        view_read_lock.lock();
+
+                        std::size_t max_payload_size;
+                        int buffer_offset = group_rpc_manager.populate_nodelist_header(destination_nodes,
+                                                                                       buffer, max_payload_size);
+                        buffer += buffer_offset;
                         if(size <= max_payload_size) {
                             return buffer;
                         } else {
@@ -269,6 +284,25 @@ public:
                                                                  payload_size, transfer_medium, pause_sending_turns, false, null_send);
     }
 
+    /**
+     * Chooses the transfer medium for a raw send: the SST for payloads up to
+     * this subgroup's SST send threshold, and RDMC for larger ones.
+     * @param payload_size The size of the payload, in bytes.
+     * @return The transfer_medium argument to pass to get_sendbuffer_ptr.
+     */
+    bool select_transfer_medium(unsigned long long int payload_size) {
+        return group_rpc_manager.view_manager.select_transfer_medium(subgroup_id, payload_size);
+    }
+
+    /**
+     * Sets the largest payload, in bytes, that this subgroup sends through
+     * the SST when the transfer medium is chosen automatically, as it is for
+     * ordered sends and queries.
+     */
+    void set_sst_send_threshold(unsigned long long int threshold) {
+        group_rpc_manager.view_manager.set_sst_send_threshold(subgroup_id, threshold);
+    }
+
     /**
      * Submits the contents of the send buffer to be multicast to the subgroup,
      * assuming it has been previously filled with a call to get_sendbuffer_ptr().
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <experimental/optional>
+#include <utility>
+#include <vector>
+
+namespace derecho {
+
+/**
+ * Holds the messages of a subgroup that are waiting for something, such as
+ * stability or persistence, by their sequence number. Sequence numbers are
+ * dense, and a sender cannot get more than a window ahead of the slowest
+ * member, so the messages waiting at any time span a bounded range of
+ * sequence numbers: they are kept in a circular array of that many slots,
+ * indexed by sequence number modulo its size, and finding, adding and
+ * removing a message takes constant time and no allocation. If a sender
+ * skips turns, its placeholder messages can fall past the end of the range;
+ * the array then doubles in size.
+ */
+template <typename T>
+class SequenceWindow {
+    std::vector<std::experimental::optional<T>> slots;
+    /** The number of messages held. */
+    size_t num_held = 0;
+    /** The lowest sequence number held; only meaningful when num_held > 0. */
+    long long int lowest = 0;
+    /** No sequence number held is higher; only meaningful when num_held > 0. */
+    long long int highest = 0;
+
+    std::experimental::optional<T>& slot(long long int seq_num) {
+        return slots[seq_num % slots.size()];
+    }
+
+    /** Resizes the array so that it holds every sequence number from low to high. */
+    void grow(long long int low, long long int high) {
+        size_t capacity = slots.size();
+        while(high - low >= (long long int)capacity) {
+            capacity *= 2;
+        }
+        std::vector<std::experimental::optional<T>> old_slots(capacity);
+        old_slots.swap(slots);
+        if(num_held) {
+            for(long long int seq_num = lowest; seq_num <= highest; ++seq_num) {
+                auto& old_slot = old_slots[seq_num % old_slots.size()];
+                if(old_slot) {
+                    slot(seq_num) = std::move(old_slot);
+                }
+            }
+        }
+    }
+
+public:
+    /** Creates a window of capacity slots. */
+    explicit SequenceWindow(size_t capacity = 1) : slots(capacity ? capacity : 1) {}
+
+    bool empty() const { return num_held == 0; }
+    size_t size() const { return num_held; }
+
+    /** Adds msg under seq_num, replacing any message already held there. */
+    void insert(long long int seq_num, T&& msg) {
+        assert(seq_num >= 0);
+        if(!num_held) {
+            lowest = highest = seq_num;
+        } else {
+            const long long int low = std::min(lowest, seq_num);
+            const long long int high = std::max(highest, seq_num);
+            if(high - low >= (long long int)slots.size()) {
+                grow(low, high);
+            }
+            lowest = low;
+            highest = high;
+        }
+        auto& s = slot(seq_num);
+        if(!s) {
+            num_held++;
+        }
+        s = std::move(msg);
+    }
+
+    /** Returns the message held under seq_num, or nullptr if there is none. */
+    T* find(long long int seq_num) {
+        if(!num_held || seq_num < lowest || seq_num > highest) {
+            return nullptr;
+        }
+        auto& s = slot(seq_num);
+        return s ? &*s : nullptr;
+    }
+
+    /** Removes the message held under seq_num, if there is one. */
+    void erase(long long int seq_num) {
+        if(!find(seq_num)) {
+            return;
+        }
+        slot(seq_num) = std::experimental::nullopt;
+        if(--num_held && seq_num == lowest) {
+            while(!slot(lowest)) {
+                lowest++;
+            }
+        }
+    }
+
+    /** Returns the lowest sequence number held; the window must not be empty. */
+    long long int front_seq_num() const {
+        assert(num_held);
+        return lowest;
+    }
+
+    /** Calls f(seq_num, msg) on each message held, in sequence number order. */
+    template <typename F>
+    void for_each(F&& f) {
+        for(long long int seq_num = lowest; num_held && seq_num <= highest; ++seq_num) {
+            auto& s = slot(seq_num);
+            if(s) {
+                f(seq_num, *s);
+            }
+        }
+    }
+
+    /** Removes every message, keeping the slots for reuse. */
+    void clear() {
+        for(auto& s : slots) {
+            s = std::experimental::nullopt;
+        }
+        num_held = 0;
+    }
+};
+}  // namespace derecho
@@ -378,20 +378,22 @@ void ViewManager::register_predicates() {
         int leader = curr_view->rank_of_leader();
         logger->debug("Detected that leader proposed change #{}. Acknowledging.", gmsSST.num_changes[leader]);
         if(myRank != leader) {
+            // Read all the fields from one copy of the leader's row
+            const sst::row_snapshot leader_row = gmsSST.snapshot_row(leader);
             // Echo the count
-            gmssst::set(gmsSST.num_changes[myRank], gmsSST.num_changes[leader]);
+            gmssst::set(gmsSST.num_changes[myRank], leader_row[gmsSST.num_changes]);
 
             // Echo (copy) the vector including the new changes
-            gmssst::set(gmsSST.changes[myRank], gmsSST.changes[leader], gmsSST.changes.size());
+            gmssst::set(gmsSST.changes[myRank], leader_row[gmsSST.changes], gmsSST.changes.size());
             // Echo the new member's IP
-            gmssst::set(gmsSST.joiner_ips[myRank], gmsSST.joiner_ips[leader], gmsSST.joiner_ips.size());
-            gmssst::set(gmsSST.num_committed[myRank], gmsSST.num_committed[leader]);
+            gmssst::set(gmsSST.joiner_ips[myRank], leader_row[gmsSST.joiner_ips], gmsSST.joiner_ips.size());
+            gmssst::set(gmsSST.num_committed[myRank], leader_row[gmsSST.num_committed]);
         }
 
         // Notice a new request, acknowledge it
         gmssst::set(gmsSST.num_acked[myRank], gmsSST.num_changes[myRank]);
         gmsSST.put(gmsSST.changes.get_base() - gmsSST.getBaseAddress(),
-                   gmsSST.num_received.get_base() - gmsSST.changes.get_base());
+                   gmsSST.num_installed.get_base() + sizeof(gmsSST.num_installed[0]) - gmsSST.changes.get_base());
         logger->debug("Wedging current view.");
         curr_view->wedge();
         logger->debug("Done wedging current view.");
@@ -704,17 +706,19 @@ void ViewManager::construct_multicast_group(CallbackSet callbacks,
     std::map<subgroup_id_t, std::vector<node_id_t>> subgroup_to_membership;
     std::map<subgroup_id_t, Mode> subgroup_to_mode;
 
-    uint32_t num_received_size = make_subgroup_maps(std::unique_ptr<View>(), *curr_view,
-                                                    subgroup_to_shard_and_rank,
-                                                    subgroup_to_senders_and_sender_rank,
-                                                    subgroup_to_num_received_offset,
-                                                    subgroup_to_membership,
-                                                    subgroup_to_mode);
+    std::vector<uint32_t> num_received_sizes = make_subgroup_maps(std::unique_ptr<View>(), *curr_view,
+                                                                  subgroup_to_shard_and_rank,
+                                                                  subgroup_to_senders_and_sender_rank,
+                                                                  subgroup_to_num_received_offset,
+                                                                  subgroup_to_membership,
+                                                                  subgroup_to_mode);
     const auto num_subgroups = curr_view->subgroup_shard_views.size();
     curr_view->gmsSST = std::make_shared<DerechoSST>(
             sst::SSTParams(curr_view->members, curr_view->members[curr_view->my_rank],
-                           [this](const uint32_t node_id) { report_failure(node_id); }, curr_view->failed, false),
-            num_subgroups, num_received_size, derecho_params.window_size);
+                           [this](const uint32_t node_id) { report_failure(node_id); }, curr_view->failed, false, true,
+                           sst::WaitPolicy::SPIN_THEN_BLOCK, derecho_params.num_predicate_threads,
+                           derecho_params.sst_row_layout, derecho_params.sst_row_seqlock),
+            num_subgroups, num_received_sizes, MulticastGroup::compute_sst_ring_size(derecho_params));
 
     curr_view->multicast_group = std::make_unique<MulticastGroup>(
             curr_view->members, curr_view->members[curr_view->my_rank],
@@ -731,16 +735,18 @@ void ViewManager::transition_multicast_group() {
     std::map<subgroup_id_t, uint32_t> subgroup_to_num_received_offset;
     std::map<subgroup_id_t, std::vector<node_id_t>> subgroup_to_membership;
     std::map<subgroup_id_t, Mode> subgroup_to_mode;
-    uint32_t num_received_size = make_subgroup_maps(curr_view, *next_view, subgroup_to_shard_and_rank,
-                                                    subgroup_to_senders_and_sender_rank,
-                                                    subgroup_to_num_received_offset,
-                                                    subgroup_to_membership,
-                                                    subgroup_to_mode);
+    std::vector<uint32_t> num_received_sizes = make_subgroup_maps(curr_view, *next_view, subgroup_to_shard_and_rank,
+                                                                  subgroup_to_senders_and_sender_rank,
+                                                                  subgroup_to_num_received_offset,
+                                                                  subgroup_to_membership,
+                                                                  subgroup_to_mode);
     const auto num_subgroups = next_view->subgroup_shard_views.size();
     next_view->gmsSST = std::make_shared<DerechoSST>(
             sst::SSTParams(next_view->members, next_view->members[next_view->my_rank],
-                           [this](const uint32_t node_id) { report_failure(node_id); }, next_view->failed, false),
-            num_subgroups, num_received_size, derecho_params.window_size);
+                           [this](const uint32_t node_id) { report_failure(node_id); }, next_view->failed, false, true,
+                           sst::WaitPolicy::SPIN_THEN_BLOCK, derecho_params.num_predicate_threads,
+                           derecho_params.sst_row_layout, derecho_params.sst_row_seqlock),
+            num_subgroups, num_received_sizes, MulticastGroup::compute_sst_ring_size(derecho_params));
 
     next_view->multicast_group = std::make_unique<MulticastGroup>(
             next_view->members, next_view->members[next_view->my_rank], next_view->gmsSST,
@@ -794,14 +800,15 @@ void ViewManager::commit_join(const View& new_view, tcp::socket& client_socket)
     mutils::post_object(bind_socket_write, derecho_params);
 }
 
-uint32_t ViewManager::make_subgroup_maps(const std::unique_ptr<View>& prev_view,
-                                         View& curr_view,
-                                         std::map<subgroup_id_t, std::pair<uint32_t, uint32_t>>& subgroup_to_shard_and_rank,
-                                         std::map<subgroup_id_t, std::pair<std::vector<int>, int>>& subgroup_to_senders_and_sender_rank,
-                                         std::map<subgroup_id_t, uint32_t>& subgroup_to_num_received_offset,
-                                         std::map<subgroup_id_t, std::vector<node_id_t>>& subgroup_to_membership,
-                                         std::map<subgroup_id_t, Mode>& subgroup_to_mode) {
+std::vector<uint32_t> ViewManager::make_subgroup_maps(const std::unique_ptr<View>& prev_view,
+                                                      View& curr_view,
+                                                      std::map<subgroup_id_t, std::pair<uint32_t, uint32_t>>& subgroup_to_shard_and_rank,
+                                                      std::map<subgroup_id_t, std::pair<std::vector<int>, int>>& subgroup_to_senders_and_sender_rank,
+                                                      std::map<subgroup_id_t, uint32_t>& subgroup_to_num_received_offset,
+                                                      std::map<subgroup_id_t, std::vector<node_id_t>>& subgroup_to_membership,
+                                                      std::map<subgroup_id_t, Mode>& subgroup_to_mode) {
     uint32_t num_received_offset = 0;
+    std::vector<uint32_t> num_received_sizes;
     bool previous_was_ok = !prev_view || prev_view->is_adequately_provisioned;
     int32_t initial_next_unassigned_rank = curr_view.next_unassigned_rank;
     for(const auto& subgroup_type : subgroup_info.membership_function_order) {
@@ -824,7 +831,7 @@ uint32_t ViewManager::make_subgroup_maps(const std::unique_ptr<View>& prev_view,
             subgroup_to_membership.clear();
             subgroup_to_mode.clear();
 
-            return 0;
+            return {};
         }
         std::size_t num_subgroups = subgroup_shard_views.size();
         curr_view.subgroup_ids_by_type[subgroup_type] = std::vector<subgroup_id_t>(num_subgroups);
@@ -871,9 +878,10 @@ uint32_t ViewManager::make_subgroup_maps(const std::unique_ptr<View>& prev_view,
             curr_view.subgroup_shard_views.emplace_back(
                     std::move(subgroup_shard_views[subgroup_index]));
             num_received_offset += max_shard_senders;
+            num_received_sizes.push_back(max_shard_senders);
         }
     }
-    return num_received_offset;
+    return num_received_sizes;
 }
 
 /**
@@ -1103,6 +1111,39 @@ void ViewManager::send(subgroup_id_t subgroup_num) {
     }
 }
 
+char* ViewManager::get_sendbuffer_ptr_blocking(subgroup_id_t subgroup_num, long long unsigned int payload_size,
+                                               bool transfer_medium, int pause_sending_turns,
+                                               bool cooked_send, bool null_send) {
+    shared_lock_t lock(view_mutex);
+    while(true) {
+        char* buf = curr_view->multicast_group->get_sendbuffer_ptr_blocking(subgroup_num, payload_size, transfer_medium,
+                                                                            pause_sending_turns, cooked_send, null_send);
+        if(buf || !curr_view->multicast_group->is_wedged()) {
+            return buf;
+        }
+        // The view is changing; wait for space in the next one
+        view_change_cv.wait(lock);
+    }
+}
+
+std::future<bool> ViewManager::send_async(subgroup_id_t subgroup_num, long long unsigned int payload_size,
+                                          const send_fill_callback& fill, bool transfer_medium,
+                                          int pause_sending_turns, bool cooked_send, bool null_send) {
+    shared_lock_t lock(view_mutex);
+    return curr_view->multicast_group->send_async(subgroup_num, payload_size, fill, transfer_medium,
+                                                  pause_sending_turns, cooked_send, null_send);
+}
+
+bool ViewManager::select_transfer_medium(subgroup_id_t subgroup_num, long long unsigned int payload_size) {
+    shared_lock_t lock(view_mutex);
+    return curr_view->multicast_group->select_transfer_medium(subgroup_num, payload_size);
+}
+
+void ViewManager::set_sst_send_threshold(subgroup_id_t subgroup_num, long long unsigned int threshold) {
+    shared_lock_t lock(view_mutex);
+    curr_view->multicast_group->set_sst_send_threshold(subgroup_num, threshold);
+}
+
 void ViewManager::add_view_upcall(const view_upcall_t& upcall) {
     view_upcalls.emplace_back(upcall);
 }
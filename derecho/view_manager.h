@@ -193,14 +193,16 @@ private:
     void transition_multicast_group();
     /** Initializes the current View with subgroup information, and creates the
      * subgroup-related maps that MulticastGroup's constructor needs based on
-     * this information. */
-    uint32_t make_subgroup_maps(const std::unique_ptr<View>& prev_view,
-                                View& curr_view,
-                                std::map<subgroup_id_t, std::pair<uint32_t, uint32_t>>& subgroup_to_shard_n_index,
-                                std::map<subgroup_id_t, std::pair<std::vector<int>, int>>& subgroup_to_senders_n_sender_index,
-                                std::map<subgroup_id_t, uint32_t>& subgroup_to_num_received_offset,
-                                std::map<subgroup_id_t, std::vector<node_id_t>>& subgroup_to_membership,
-                                std::map<subgroup_id_t, Mode>& subgroup_to_mode);
+     * this information. Returns, for each subgroup, the number of entries it
+     * needs in DerechoSST's num_received field, or an empty vector if the
+     * View is not adequately provisioned. */
+    std::vector<uint32_t> make_subgroup_maps(const std::unique_ptr<View>& prev_view,
+                                             View& curr_view,
+                                             std::map<subgroup_id_t, std::pair<uint32_t, uint32_t>>& subgroup_to_shard_n_index,
+                                             std::map<subgroup_id_t, std::pair<std::vector<int>, int>>& subgroup_to_senders_n_sender_index,
+                                             std::map<subgroup_id_t, uint32_t>& subgroup_to_num_received_offset,
+                                             std::map<subgroup_id_t, std::vector<node_id_t>>& subgroup_to_membership,
+                                             std::map<subgroup_id_t, Mode>& subgroup_to_mode);
     /** Constructs a map from node ID -> IP address from the parallel vectors in the given View. */
     static std::map<node_id_t, ip_addr> make_member_ips_map(const View& view);
 
@@ -299,6 +301,25 @@ public:
     /** Instructs the managed DerechoGroup's to send the next message. This
      * returns immediately; the send is scheduled to happen some time in the future. */
     void send(subgroup_id_t subgroup_num);
+    /** Like get_sendbuffer_ptr, but waits until there is space in the send
+     * buffer, across view changes, instead of returning nullptr. Returns
+     * nullptr only if the message is too large to ever be sent. */
+    char* get_sendbuffer_ptr_blocking(subgroup_id_t subgroup_num, long long unsigned int payload_size,
+                                      bool transfer_medium = true, int pause_sending_turns = 0,
+                                      bool cooked_send = false, bool null_send = false);
+    /** Queues a message to be sent once there is space in the current
+     * view's send buffer; see MulticastGroup::send_async. The returned
+     * future is set to false if the view changes before it is sent. */
+    std::future<bool> send_async(subgroup_id_t subgroup_num, long long unsigned int payload_size,
+                                 const send_fill_callback& fill, bool transfer_medium = true,
+                                 int pause_sending_turns = 0, bool cooked_send = false,
+                                 bool null_send = false);
+    /** Returns the transfer medium to pass to get_sendbuffer_ptr for a
+     * payload of payload_size bytes, chosen by the subgroup's SST send threshold. */
+    bool select_transfer_medium(subgroup_id_t subgroup_num, long long unsigned int payload_size);
+    /** Sets the largest payload a subgroup sends through the SST when its
+     * transfer medium is chosen automatically. */
+    void set_sst_send_threshold(subgroup_id_t subgroup_num, long long unsigned int threshold);
 
     /**
      * @return a reference to the current View, wrapped in a container that
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace sst {
+/**
+ * A field of a set of rows, such as one subgroup's seq_num in the rows of
+ * its shard, lies at a fixed offset within each row, so its values are
+ * found at the byte offsets of the rows from the field's value in row 0.
+ * Computing those offsets once lets the minimum of the field be taken with
+ * vector gathers, 8 rows at a time with AVX-512 or 4 with AVX2, when the
+ * build targets them; otherwise, and for the rows left over, the rows are
+ * read one at a time. The offsets are 64 bits wide, since a table of large
+ * rows can span more than 2 GiB.
+ */
+
+/** Returns the byte offset of each of the given rows from row 0, for rows
+ * of row_len bytes. */
+inline std::vector<int64_t> row_offsets(const std::vector<uint32_t>& rows, int row_len) {
+    std::vector<int64_t> offsets;
+    offsets.reserve(rows.size());
+    for(const uint32_t row : rows) {
+        offsets.push_back((int64_t)row * row_len);
+    }
+    return offsets;
+}
+
+/** Returns the least of the long long ints at base + offsets[i], for each
+ * of the num_offsets offsets; num_offsets must not be 0. */
+inline long long int column_min(const volatile char* base, const int64_t* offsets, size_t num_offsets) {
+    const char* column = const_cast<const char*>(base);
+    size_t i = 0;
+    long long int min = *(const volatile long long int*)(base + offsets[0]);
+#if defined(__AVX512F__)
+    if(num_offsets >= 8) {
+        __m512i mins = _mm512_set1_epi64(min);
+        for(; i + 8 <= num_offsets; i += 8) {
+            const __m512i index = _mm512_loadu_si512((const void*)(offsets + i));
+            mins = _mm512_min_epi64(mins, _mm512_i64gather_epi64(index, column, 1));
+        }
+        min = _mm512_reduce_min_epi64(mins);
+    }
+#elif defined(__AVX2__)
+    if(num_offsets >= 4) {
+        __m256i mins = _mm256_set1_epi64x(min);
+        for(; i + 4 <= num_offsets; i += 4) {
+            const __m256i index = _mm256_loadu_si256((const __m256i*)(offsets + i));
+            const __m256i values = _mm256_i64gather_epi64((const long long int*)column, index, 1);
+            // AVX2 has no 64-bit min; take the values that compare lower
+            mins = _mm256_blendv_epi8(mins, values, _mm256_cmpgt_epi64(mins, values));
+        }
+        alignas(32) long long int lanes[4];
+        _mm256_store_si256((__m256i*)lanes, mins);
+        min = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+    }
+#else
+    (void)column;
+#endif
+    for(; i < num_offsets; ++i) {
+        const long long int value = *(const volatile long long int*)(base + offsets[i]);
+        min = std::min(min, value);
+    }
+    return min;
+}
+
+/** Returns the least of the long long ints at base + offsets[i], for each
+ * offset; offsets must not be empty. */
+inline long long int column_min(const volatile char* base, const std::vector<int64_t>& offsets) {
+    return column_min(base, offsets.data(), offsets.size());
+}
+}
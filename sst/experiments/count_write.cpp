@@ -1,3 +1,4 @@
+#include <atomic>
 #include <chrono>
 #include <cstdlib>
 #include <ctime>
@@ -6,6 +7,7 @@
 #include <map>
 
 #include "sst/poll_utils.h"
+#include "sst/shm.h"
 #include "sst/sst.h"
 //Since all SST instances are named sst, we can use this convenient hack
 #define LOCAL sst.get_local_index()
@@ -23,10 +25,11 @@ using namespace sst;
 class mySST : public SST<mySST> {
 public:
     mySST(const vector<uint32_t>& _members, uint32_t my_id) : SST<mySST>(this, SSTParams{_members, my_id}) {
-        SSTInit(a, heartbeat);
+        SSTInit(a, heartbeat, time);
     }
     SSTField<int> a;
     SSTField<bool> heartbeat;
+    SSTField<double> time;
 };
 
 int main() {
@@ -40,8 +43,13 @@ int main() {
         cin >> ip_addrs[i];
     }
 
-    // initialize the rdma resources
-    verbs_initialize(ip_addrs, node_rank);
+    // initialize the rdma resources, or the shared memory transport if
+    // all the nodes run on this host
+    if(getenv("SST_USE_SHM")) {
+        shm_initialize(ip_addrs, node_rank);
+    } else {
+        verbs_initialize(ip_addrs, node_rank);
+    }
 
     // form a group with a subset of all the nodes
     vector<uint32_t> members(num_nodes);
@@ -54,9 +62,10 @@ int main() {
     sst.a[node_rank] = 0;
     sst.put((char*)std::addressof(sst.a[0]) - sst.getBaseAddress(), sizeof(int));
 
-    auto check_failures_loop = [&sst]() {
+    std::atomic<bool> shutdown{false};
+    auto check_failures_loop = [&sst, &shutdown]() {
         pthread_setname_np(pthread_self(), "check_failures");
-        while(true) {
+        while(!shutdown) {
             std::this_thread::sleep_for(std::chrono::microseconds(1000));
             sst.put_with_completion((char*)std::addressof(sst.heartbeat[0]) - sst.getBaseAddress(), sizeof(bool));
         }
@@ -95,7 +104,7 @@ int main() {
     };
 
     // trigger. Increments self value
-    auto g = [&start_time](mySST& sst) {
+    auto g = [&start_time, &shutdown, &failures_thread](mySST& sst) {
         ++(sst.a[LOCAL]);
         sst.put((char*)std::addressof(sst.a[0]) - sst.getBaseAddress(), sizeof(int));
         if(sst.a[LOCAL] == 1000000) {
@@ -105,36 +114,20 @@ int main() {
             // my_time is time taken to count
             double my_time = ((end_time.tv_sec * 1e9 + end_time.tv_nsec) - (start_time.tv_sec * 1e9 + start_time.tv_nsec)) / 1e9;
             int node_rank = sst.get_local_index();
-            // node 0 finds the average by reading all the times taken by remote nodes
+            // every node publishes its time through the SST, so the exchange
+            // works over either transport
+            sst.time[node_rank] = my_time;
+            sst.put((char*)std::addressof(sst.time[0]) - sst.getBaseAddress(), sizeof(double));
+            // node 0 finds the average of the times taken by all the nodes
             // Anyway, the values will be quite close as the counting is synchronous
             if(node_rank == 0) {
                 int num_nodes = sst.get_num_rows();
-                resources* res;
-                double times[num_nodes];
-                const auto tid = std::this_thread::get_id();
-                // get id first
-                uint32_t id = util::polling_data.get_index(tid);
-                util::polling_data.set_waiting(tid);
-
-                // read the other nodes' time
-                for(int i = 0; i < num_nodes; ++i) {
-                    if(i == node_rank) {
-                        times[i] = my_time;
-                    } else {
-                        res = new resources(i, (char*)&my_time, (char*)&times[i], sizeof(double), sizeof(double));
-                        res->post_remote_read(id, sizeof(double));
-                        free(res);
-                    }
-                }
-                for(int i = 0; i < num_nodes; ++i) {
-                    util::polling_data.get_completion_entry(tid);
-                }
-                util::polling_data.reset_waiting(tid);
-
                 double sum = 0.0;
                 // compute the average
                 for(int i = 0; i < num_nodes; ++i) {
-                    sum += times[i];
+                    while(sst.time[i] == 0) {
+                    }
+                    sum += sst.time[i];
                 }
                 ofstream fout;
                 fout.open("data_count_write", ofstream::app);
@@ -149,13 +142,16 @@ int main() {
                     sync(i);
                 }
             } else {
-                resources* res;
-                double no_need;
-                res = new resources(0, (char*)&my_time, (char*)&no_need, sizeof(double), sizeof(double));
                 sync(0);
-                free(res);
             }
-            verbs_destroy();
+            // stop the heartbeat puts before the transport is torn down
+            shutdown = true;
+            failures_thread.join();
+            if(get_transport_type() == TransportType::SHARED_MEMORY) {
+                shm_destroy();
+            } else {
+                verbs_destroy();
+            }
             exit(0);
         }
     };
@@ -42,6 +42,7 @@ struct exp_result {
 
 int main() {
     constexpr uint max_msg_size = 10, window_size = 1000;
+    constexpr uint ring_size = sst::ring_size_for(window_size, max_msg_size);
     unsigned int last_message_index = -1;
     bool done = false;
     // input number of nodes and the local node id
@@ -64,7 +65,7 @@ int main() {
 
     std::shared_ptr<multicast_sst> sst = make_shared<multicast_sst>(
             sst::SSTParams(members, node_id),
-            window_size);
+            ring_size, num_nodes);
 
     auto check_failures_loop = [&sst]() {
         pthread_setname_np(pthread_self(), "check_failures");
@@ -97,15 +98,15 @@ int main() {
     if(!num_times) {
         num_times = 1;
     }
-    auto receiver_trig = [num_times, num_nodes, node_id, sst_receive_handler](multicast_sst& sst) {
+    vector<sst::ring_reader> readers(num_nodes);
+    auto receiver_trig = [num_times, num_nodes, node_id, sst_receive_handler, readers](multicast_sst& sst) mutable {
         bool update_sst = false;
         for(uint i = 0; i < num_times; ++i) {
             for(uint j = 0; j < num_nodes; ++j) {
-                uint32_t slot = sst.num_received_sst[node_id][j] % window_size;
-                if((int64_t)sst.slots[j][slot].next_seq == (sst.num_received_sst[node_id][j]) / window_size + 1) {
+                if(readers[j].ready(sst.ring_tail[j][0])) {
+                    auto message = readers[j].next(sst.ring[j], ring_size);
                     sst_receive_handler(j, sst.num_received_sst[node_id][j],
-                                        sst.slots[j][slot].buf,
-                                        sst.slots[j][slot].size);
+                                        message.first, message.second);
                     sst.num_received_sst[node_id][j]++;
                     update_sst = true;
                 }
@@ -119,7 +120,7 @@ int main() {
     sst->predicates.insert(receiver_pred, receiver_trig,
                            sst::PredicateType::RECURRENT);
 
-    sst::multicast_group<multicast_sst> g(sst, indices, window_size);
+    sst::multicast_group<multicast_sst> g(sst, indices, ring_size);
     auto send = [&]() {
         volatile char* buf;
         while((buf = g.get_buffer(max_msg_size)) == NULL) {
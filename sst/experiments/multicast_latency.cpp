@@ -12,6 +12,7 @@ volatile bool done = false;
 
 int main() {
     constexpr uint max_msg_size = 1, window_size = 1000;
+    constexpr uint ring_size = sst::ring_size_for(window_size, max_msg_size);
     const unsigned int num_messages = 1000000;
     // input number of nodes and the local node id
     uint32_t node_id, num_nodes;
@@ -42,7 +43,7 @@ int main() {
 
     std::shared_ptr<multicast_sst> sst = make_shared<multicast_sst>(
             sst::SSTParams(members, node_id),
-            window_size);
+            ring_size, num_nodes);
 
     auto check_failures_loop = [&sst]() {
         pthread_setname_np(pthread_self(), "check_failures");
@@ -77,15 +78,15 @@ int main() {
     if(!num_times) {
         num_times = 1;
     }
-    auto receiver_trig = [num_times, num_nodes, node_id, sst_receive_handler](multicast_sst& sst) {
+    vector<sst::ring_reader> readers(num_nodes);
+    auto receiver_trig = [num_times, num_nodes, node_id, sst_receive_handler, readers](multicast_sst& sst) mutable {
         bool update_sst = false;
         for(uint i = 0; i < num_times; ++i) {
             for(uint j = 0; j < num_nodes; ++j) {
-                uint32_t slot = sst.num_received_sst[node_id][j] % window_size;
-                if((int64_t)sst.slots[j][slot].next_seq == (sst.num_received_sst[node_id][j]) / window_size + 1) {
+                if(readers[j].ready(sst.ring_tail[j][0])) {
+                    auto message = readers[j].next(sst.ring[j], ring_size);
                     sst_receive_handler(j, sst.num_received_sst[node_id][j],
-                                        sst.slots[j][slot].buf,
-                                        sst.slots[j][slot].size);
+                                        message.first, message.second);
                     sst.num_received_sst[node_id][j]++;
                     update_sst = true;
                 }
@@ -101,7 +102,7 @@ int main() {
     vector<uint32_t> indices;
     iota(indices.begin(), indices.end(), 0);
     multicast_group<multicast_sst> g(
-            sst, indices, window_size);
+            sst, indices, ring_size);
     for(uint i = 0; i < num_messages; ++i) {
         volatile char* buf;
         while((buf = g.get_buffer(max_msg_size)) == NULL) {
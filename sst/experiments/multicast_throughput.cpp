@@ -9,6 +9,7 @@
 #include "sst/max_msg_size.h"
 #include "sst/multicast.h"
 #include "sst/multicast_sst.h"
+#include "sst/shm.h"
 
 using namespace std;
 using namespace sst;
@@ -29,6 +30,7 @@ struct exp_results {
 int main(int argc, char* argv[]) {
     assert(max_msg_size == 1);
     constexpr uint max_msg_size = 1, window_size = 1000;
+    constexpr uint ring_size = sst::ring_size_for(window_size, max_msg_size);
     const unsigned int num_messages = 1000000;
     if(argc < 2) {
         cout << "Insufficient number of command line arguments" << endl;
@@ -47,8 +49,13 @@ int main(int argc, char* argv[]) {
         cin >> ip_addrs[i];
     }
 
-    // initialize the rdma resources
-    verbs_initialize(ip_addrs, node_id);
+    // initialize the rdma resources, or the shared memory transport if
+    // all the nodes run on this host
+    if(getenv("SST_USE_SHM")) {
+        shm_initialize(ip_addrs, node_id);
+    } else {
+        verbs_initialize(ip_addrs, node_id);
+    }
 
     std::vector<uint32_t> members(num_nodes);
     for(uint i = 0; i < num_nodes; ++i) {
@@ -67,7 +74,7 @@ int main(int argc, char* argv[]) {
 
     std::shared_ptr<multicast_sst> sst = make_shared<multicast_sst>(
             sst::SSTParams(members, node_id),
-            window_size,
+            ring_size,
             num_senders);
 
     auto check_failures_loop = [&sst]() {
@@ -99,16 +106,15 @@ int main(int argc, char* argv[]) {
         return true;
     };
     vector<int64_t> last_max_num_received(num_senders, -1);
-    auto receiver_trig = [&completed, last_max_num_received, window_size, num_nodes, node_id, sst_receive_handler,
+    vector<sst::ring_reader> readers(num_senders);
+    auto receiver_trig = [&completed, last_max_num_received, readers, window_size, num_nodes, node_id, sst_receive_handler,
                           row_offset, num_senders](multicast_sst& sst) mutable {
         while(true) {
             for(uint j = 0; j < num_senders; ++j) {
                 auto num_received = sst.num_received_sst[node_id][j] + 1;
-                uint32_t slot = num_received % window_size;
-                if((int64_t)sst.slots[row_offset + j][slot].next_seq == (num_received / window_size + 1)) {
-                    sst_receive_handler(j, num_received,
-                                        sst.slots[row_offset + j][slot].buf,
-                                        sst.slots[row_offset + j][slot].size);
+                if(readers[j].ready(sst.ring_tail[row_offset + j][0])) {
+                    auto message = readers[j].next(sst.ring[row_offset + j], ring_size);
+                    sst_receive_handler(j, num_received, message.first, message.second);
                     sst.num_received_sst[node_id][j]++;
                 }
             }
@@ -146,7 +152,7 @@ int main(int argc, char* argv[]) {
             is_sender[i] = 0;
         }
     }
-    sst::multicast_group<multicast_sst> g(sst, indices, window_size, is_sender);
+    sst::multicast_group<multicast_sst> g(sst, indices, ring_size, is_sender);
     // now
     sst->predicates.insert(receiver_pred, receiver_trig,
                            sst::PredicateType::RECURRENT);
@@ -0,0 +1,84 @@
+#pragma once
+
+/**
+ * @file histogram.h
+ * Contains a simple histogram of durations, used to report how the SST
+ * predicate evaluation thread spends its time.
+ */
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+namespace sst {
+
+/**
+ * Counts durations in buckets whose bounds grow in powers of two
+ * microseconds: bucket 0 holds durations under 1us, and bucket i > 0 holds
+ * durations in [2^(i-1), 2^i) us. The last bucket also holds anything
+ * longer. Recording is lock-free, so it can be read while being updated.
+ */
+class duration_histogram {
+public:
+    static const int num_buckets = 32;
+
+private:
+    std::array<std::atomic<uint64_t>, num_buckets> buckets;
+    std::atomic<uint64_t> total_ns;
+
+public:
+    duration_histogram() : total_ns(0) {
+        for(auto& bucket : buckets) {
+            bucket = 0;
+        }
+    }
+
+    /** Adds a duration, in nanoseconds, to the histogram. */
+    void record(uint64_t ns) {
+        uint64_t us = ns / 1000;
+        int bucket = 0;
+        while(us > 0 && bucket < num_buckets - 1) {
+            us >>= 1;
+            ++bucket;
+        }
+        buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        total_ns.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    /** Returns the number of durations recorded in a bucket. */
+    uint64_t count(int bucket) const {
+        return buckets[bucket].load(std::memory_order_relaxed);
+    }
+
+    /** Returns the number of durations recorded in all buckets. */
+    uint64_t count() const {
+        uint64_t sum = 0;
+        for(int i = 0; i < num_buckets; ++i) {
+            sum += count(i);
+        }
+        return sum;
+    }
+
+    /** Returns the sum of all recorded durations, in nanoseconds. */
+    uint64_t total() const {
+        return total_ns.load(std::memory_order_relaxed);
+    }
+
+    /** Prints the upper bound and count of each non-empty bucket. */
+    void print(std::ostream& out) const {
+        for(int i = 0; i < num_buckets; ++i) {
+            if(count(i) == 0) {
+                continue;
+            }
+            if(i == num_buckets - 1) {
+                out << ">=" << (1ull << (i - 1)) << "us: " << count(i) << std::endl;
+            } else {
+                out << "<" << (1ull << i) << "us: " << count(i) << std::endl;
+            }
+        }
+        out << "total: " << count() << " in " << total() / 1000 << "us" << std::endl;
+    }
+};
+
+}  // namespace sst
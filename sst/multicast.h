@@ -1,11 +1,17 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <deque>
 #include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <vector>
 
@@ -15,12 +21,26 @@
 namespace sst {
 template <typename sstType>
 class multicast_group {
-    // number of messages for which get_buffer has been called
-    long long int queued_num = -1;
-    // number of messages for which RDMA write is complete
-    uint64_t num_sent = 0;
-    // the number of messages acknowledged by all the nodes
-    long long int finished_multicasts_num = -1;
+    // an entry returned by get_buffer, or a batch, that is not sent yet
+    struct unsent_entry {
+        // ring position of the wrap marker written before the entry, if any
+        uint64_t marker;
+        // ring positions of the start and end of the entry
+        uint64_t start;
+        uint64_t end;
+    };
+    static const uint64_t no_marker = UINT64_MAX;
+
+    // bytes of the ring reserved for entries so far
+    uint64_t tail = 0;
+    // bytes of the ring whose entries have been acknowledged by all the nodes
+    uint64_t head = 0;
+    // number of entries acknowledged by all the nodes
+    uint64_t num_released = 0;
+    // for each entry not yet acknowledged by all the nodes, the ring position after it
+    std::deque<uint64_t> entry_ends;
+    // entries reserved by get_buffer, in order, that send has not been called for
+    std::deque<unsent_entry> unsent_entries;
     // row of the node in the sst
     const uint32_t my_row;
     // rank of the node in the members list
@@ -40,38 +60,176 @@ class multicast_group {
     // start indexes for sst fields it uses
     // need to know the range it can operate on
     const uint32_t num_received_offset;
-    const uint32_t slots_offset;
+    const uint32_t ring_index;
 
     // number of members
     const uint32_t num_members;
     // number of senders
     uint32_t num_senders;
-    // window size
-    const uint32_t window_size;
+    // size of each sender's ring, in bytes
+    const uint32_t ring_size;
+    // largest message that can be sent
+    const uint32_t max_message_size;
+
+    // whether several messages are packed into each entry
+    const bool batching;
+    // how long a batch may wait for more messages before it is sent
+    const uint32_t batch_timeout_us;
+    // the messages of the open batch, copied into the ring when it is sent
+    std::vector<char> batch_buffer;
+    // bytes of batch_buffer in use, including the message being written
+    uint32_t batch_len = 0;
+    // bytes of batch_buffer holding messages that send has been called for
+    uint32_t batch_finished_len = 0;
+    // whether a batch has been started and not sent yet
+    bool batch_open = false;
+    // whether get_buffer has returned a message that send has not been called for
+    bool message_in_progress = false;
+    // whether close has been called, after which nothing more is sent
+    bool closed = false;
+    // when the open batch got its first message
+    std::chrono::steady_clock::time_point batch_start;
+    // wakes the timeout thread when a batch is opened, when a message of an
+    // overdue batch is finished, and on shutdown; used with msg_send_mutex
+    std::condition_variable batch_cv;
+    // whether the timeout thread waits for send to finish an overdue batch's message
+    bool flush_waiting_for_send = false;
+    std::atomic<bool> thread_shutdown{false};
 
     std::thread timeout_thread;
 
+    volatile char* my_ring() {
+        return sst->ring[my_row] + ring_index * ring_size;
+    }
+
+    // releases the entries that all the nodes have received
+    void release_entries() {
+        long long int min_multicast_num = sst->num_received_sst[my_row][num_received_offset + my_sender_index];
+        for(auto i : row_indices) {
+            if(sst->num_received_sst[i][num_received_offset + my_sender_index] < min_multicast_num) {
+                min_multicast_num = sst->num_received_sst[i][num_received_offset + my_sender_index];
+            }
+        }
+        while((long long int)num_released < min_multicast_num + 1 && !entry_ends.empty()) {
+            head = entry_ends.front();
+            entry_ends.pop_front();
+            num_released++;
+        }
+    }
+
+    // returns where an entry of len bytes would start, moving past the end of
+    // the ring if it does not fit there
+    uint64_t entry_start(uint32_t len) const {
+        if(tail % ring_size + len > ring_size) {
+            return tail + ring_size - tail % ring_size;
+        }
+        return tail;
+    }
+
+    // returns whether an entry of len bytes fits in the free part of the ring
+    bool has_room(uint32_t len) {
+        if(entry_start(len) + len - head > ring_size) {
+            release_entries();
+        }
+        return entry_start(len) + len - head <= ring_size;
+    }
+
+    // reserves an entry for a message of msg_size bytes, which must have room,
+    // and returns where its message goes; must hold msg_send_mutex
+    volatile char* reserve(uint32_t msg_size) {
+        const uint32_t len = ring_entry_len(msg_size);
+        unsent_entry entry{no_marker, entry_start(len), 0};
+        if(entry.start != tail) {
+            entry.marker = tail;
+            ((volatile ring_entry_header*)(my_ring() + tail % ring_size))->size = wrap_marker;
+        }
+        entry.end = entry.start + len;
+        tail = entry.end;
+        entry_ends.push_back(tail);
+        unsent_entries.push_back(entry);
+        volatile ring_entry_header* header = (volatile ring_entry_header*)(my_ring() + entry.start % ring_size);
+        header->size = msg_size;
+        return (volatile char*)(header + 1);
+    }
+
+    // writes out the oldest unsent entry, then publishes it by advancing the
+    // tail counter; must hold msg_send_mutex
+    void send_entry() {
+        assert(!unsent_entries.empty());
+        const unsent_entry entry = unsent_entries.front();
+        unsent_entries.pop_front();
+        const long long int ring_offset = (char*)sst->ring[0] + ring_index * ring_size - sst->getBaseAddress();
+        if(entry.marker != no_marker) {
+            sst->put(ring_offset + entry.marker % ring_size, sizeof(ring_entry_header));
+        }
+        sst->put(ring_offset + entry.start % ring_size, entry.end - entry.start);
+        sst->ring_tail[my_row][ring_index] = entry.end;
+        sst->put((char*)std::addressof(sst->ring_tail[0][ring_index]) - sst->getBaseAddress(),
+                 sizeof(uint64_t));
+    }
+
+    // copies the open batch into the ring and sends it; must hold msg_send_mutex
+    void send_batch() {
+        // the room for the largest batch was checked when the batch was started
+        memcpy(const_cast<char*>(reserve(batch_len)), batch_buffer.data(), batch_len);
+        batch_open = false;
+        batch_len = 0;
+        batch_finished_len = 0;
+        send_entry();
+    }
+
+    // sleeps until a batch is open, then until it times out, and sends it
+    // unless it was sent in the meantime
+    void flush_timed_out_batches() {
+        pthread_setname_np(pthread_self(), "batch_timeout");
+        std::unique_lock<std::mutex> lock(msg_send_mutex);
+        while(!thread_shutdown) {
+            if(!batch_open) {
+                batch_cv.wait(lock);
+                continue;
+            }
+            const auto deadline = batch_start + std::chrono::microseconds(batch_timeout_us);
+            if(std::chrono::steady_clock::now() < deadline) {
+                batch_cv.wait_until(lock, deadline);
+            } else if(message_in_progress) {
+                flush_waiting_for_send = true;
+                batch_cv.wait(lock);
+                flush_waiting_for_send = false;
+            } else {
+                send_batch();
+            }
+        }
+    }
+
     void initialize() {
         for(auto i : row_indices) {
             for(uint j = num_received_offset; j < num_received_offset + num_senders; ++j) {
                 sst->num_received_sst[i][j] = -1;
             }
-            for(uint j = slots_offset; j < slots_offset + window_size; ++j) {
-                sst->slots[i][j].buf[0] = 0;
-                sst->slots[i][j].next_seq = 0;
-            }
+            sst->ring_tail[i][ring_index] = 0;
         }
         sst->sync_with_members(row_indices);
         std::cout << "Initialization complete" << std::endl;
     }
 
 public:
+    /**
+     * @param ring_size The size of each sender's ring, in bytes; see
+     * ring_size_for.
+     * @param ring_index Which of the rings in each row, and which entry of
+     * ring_tail, the group uses.
+     * @param max_message_size The largest message that will be sent, at
+     * most sst::max_msg_size; in batching mode, the largest batch.
+     */
     multicast_group(std::shared_ptr<sstType> sst,
                     std::vector<uint32_t> row_indices,
-                    uint32_t window_size,
+                    uint32_t ring_size,
                     std::vector<int> is_sender = {},
                     uint32_t num_received_offset = 0,
-                    uint32_t slots_offset = 0)
+                    uint32_t ring_index = 0,
+                    uint32_t max_message_size = max_msg_size,
+                    bool batching = false,
+                    uint32_t batch_timeout_us = 50)
             : my_row(sst->get_local_index()),
               sst(sst),
               row_indices(row_indices),
@@ -83,9 +241,15 @@ public:
                   }
               }()),
               num_received_offset(num_received_offset),
-              slots_offset(slots_offset),
+              ring_index(ring_index),
               num_members(row_indices.size()),
-              window_size(window_size) {
+              ring_size(ring_size),
+              max_message_size(max_message_size),
+              batching(batching),
+              batch_timeout_us(batch_timeout_us),
+              batch_buffer(batching ? max_message_size : 0) {
+        assert(ring_size % sizeof(ring_entry_header) == 0);
+        assert(ring_entry_len(max_message_size) <= ring_size);
         // find my_member_index
         for(uint i = 0; i < num_members; ++i) {
             if(row_indices[i] == my_row) {
@@ -107,58 +271,116 @@ public:
             my_sender_index = -1;
         }
         initialize();
+        if(batching && my_sender_index >= 0) {
+            timeout_thread = std::thread(&multicast_group::flush_timed_out_batches, this);
+        }
+    }
+
+    ~multicast_group() {
+        {
+            std::lock_guard<std::mutex> lock(msg_send_mutex);
+            thread_shutdown = true;
+        }
+        batch_cv.notify_all();
+        if(timeout_thread.joinable()) {
+            timeout_thread.join();
+        }
     }
 
+    /**
+     * Returns a buffer for a message of msg_size bytes, or nullptr if the
+     * ring has no room for it until the receivers catch up. In batching
+     * mode, the message is added to the open batch, and a new batch (which
+     * needs room for the largest batch) is only started when it does not
+     * fit; a batch is sent when it is full or has waited batch_timeout_us
+     * for more messages.
+     */
     volatile char* get_buffer(uint32_t msg_size) {
         assert(my_sender_index >= 0);
         std::lock_guard<std::mutex> lock(msg_send_mutex);
-        assert(msg_size <= max_msg_size);
-        while(true) {
-            if(queued_num - finished_multicasts_num < window_size) {
-                queued_num++;
-                uint32_t slot = queued_num % window_size;
-                // std::cout << "queued_num " << queued_num << std::endl;
-                // std::cout << "Giving slot " << slot << std::endl;
-                // set size appropriately
-                sst->slots[my_row][slots_offset + slot].size = msg_size;
-                return sst->slots[my_row][slots_offset + slot].buf;
-            } else {
-                long long int min_multicast_num = sst->num_received_sst[my_row][num_received_offset + my_sender_index];
-                for(auto i : row_indices) {
-                    if(sst->num_received_sst[i][num_received_offset + my_sender_index] < min_multicast_num) {
-                        min_multicast_num = sst->num_received_sst[i][num_received_offset + my_sender_index];
-                    }
-                }
-                if(finished_multicasts_num == min_multicast_num) {
+        if(closed) {
+            return nullptr;
+        }
+        if(batching) {
+            assert(batch_entry_len(msg_size) <= max_message_size);
+            if(batch_open && batch_len + batch_entry_len(msg_size) > max_message_size) {
+                send_batch();
+            }
+            if(!batch_open) {
+                if(!has_room(ring_entry_len(max_message_size))) {
                     return nullptr;
-                } else {
-                    finished_multicasts_num = min_multicast_num;
                 }
+                batch_open = true;
+                batch_start = std::chrono::steady_clock::now();
+                batch_cv.notify_one();
             }
+            char* entry = batch_buffer.data() + batch_len;
+            *(uint32_t*)entry = msg_size;
+            batch_len += batch_entry_len(msg_size);
+            message_in_progress = true;
+            return entry + sizeof(uint32_t);
+        }
+        assert(msg_size <= max_message_size);
+        if(!has_room(ring_entry_len(msg_size))) {
+            return nullptr;
         }
+        return reserve(msg_size);
     }
 
     void send() {
-        // std::cout << "In send: " << std::endl;
-        uint32_t slot = num_sent % window_size;
-        // std::cout << "slot = " << slot << std::endl;
-        // std::cout << "slots_offset = " << slots_offset << std::endl;
-        num_sent++;
-        sst->slots[my_row][slots_offset + slot].next_seq++;
-        sst->put(
-                (char*)std::addressof(sst->slots[0][slots_offset + slot]) - sst->getBaseAddress(),
-                sizeof(Message));
+        std::lock_guard<std::mutex> lock(msg_send_mutex);
+        if(batching) {
+            if(!message_in_progress) {
+                // the message was dropped by close
+                return;
+            }
+            message_in_progress = false;
+            batch_finished_len = batch_len;
+            // send the batch once not even an empty message would fit
+            if(batch_len + batch_entry_len(0) > max_message_size) {
+                send_batch();
+            } else if(flush_waiting_for_send) {
+                batch_cv.notify_one();
+            }
+            return;
+        }
+        send_entry();
+    }
+
+    /** Sends the open batch now, unless a message is still being written. */
+    void flush() {
+        std::lock_guard<std::mutex> lock(msg_send_mutex);
+        if(batch_open && !message_in_progress) {
+            send_batch();
+        }
+    }
+
+    /**
+     * Stops the group from sending any more messages, once the finished
+     * messages of the open batch are sent. A message still being written is
+     * dropped from the batch, and the send called for it does nothing.
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(msg_send_mutex);
+        closed = true;
+        if(!batch_open) {
+            return;
+        }
+        message_in_progress = false;
+        batch_len = batch_finished_len;
+        if(batch_len > 0) {
+            send_batch();
+        } else {
+            batch_open = false;
+        }
     }
 
     void debug_print() {
         using std::cout;
         using std::endl;
         for(auto i : row_indices) {
-            cout << "Printing slots::next_seq" << endl;
-            for(uint j = slots_offset; j < slots_offset + window_size; ++j) {
-                cout << sst->slots[i][j].next_seq << " ";
-            }
-            cout << endl;
+            cout << "Printing ring_tail" << endl;
+            cout << sst->ring_tail[i][ring_index] << endl;
             cout << "Printing num_received_sst" << endl;
             for(uint j = num_received_offset; j < num_received_offset + num_senders; ++j) {
                 cout << sst->num_received_sst[i][j] << " ";
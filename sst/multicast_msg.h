@@ -1,11 +1,82 @@
 #pragma once
 
+#include <cstdint>
+#include <utility>
+
 #include "max_msg_size.h"
 
 namespace sst {
-struct Message {
-    char buf[max_msg_size];
+/**
+ * Each sender of a multicast group appends its messages to a ring of bytes
+ * in its own row, then advances a tail counter, the total number of bytes
+ * it has appended, to publish them. Each entry is a ring_entry_header
+ * followed by the message, padded so that the next entry stays aligned. An
+ * entry never wraps around the end of the ring: if it does not fit, a
+ * header whose size is wrap_marker is written in its place, and the entry
+ * starts at the beginning of the ring.
+ */
+struct ring_entry_header {
     uint32_t size;
-    uint64_t next_seq;
+    uint32_t reserved;
 };
+
+/** The size of a header that sends the reader to the start of the ring. */
+const uint32_t wrap_marker = UINT32_MAX;
+
+/** Returns the space an entry holding a message of the given size takes. */
+constexpr uint32_t ring_entry_len(uint32_t msg_size) {
+    return sizeof(ring_entry_header)
+           + ((msg_size + sizeof(ring_entry_header) - 1) & ~(uint32_t)(sizeof(ring_entry_header) - 1));
+}
+
+/** Returns the size of a ring that holds num_entries entries of up to
+ * max_msg_size bytes each, however the space lost at wrap-arounds falls. */
+constexpr uint32_t ring_size_for(uint32_t num_entries, uint32_t max_msg_size) {
+    return (num_entries + 1) * ring_entry_len(max_msg_size);
+}
+
+/** Tracks how far a receiver has read one sender's ring. */
+class ring_reader {
+    /** The number of bytes of the ring read so far. */
+    uint64_t position = 0;
+
+public:
+    /** Returns whether the sender, whose tail counter is tail, has
+     * published an entry that has not been read yet. */
+    bool ready(uint64_t tail) const { return position < tail; }
+
+    /** Returns the message of the next entry and its size, and moves past
+     * the entry; must only be called when ready. */
+    std::pair<volatile char*, uint32_t> next(volatile char* ring, uint32_t ring_size) {
+        volatile ring_entry_header* header = (volatile ring_entry_header*)(ring + position % ring_size);
+        if(header->size == wrap_marker) {
+            position += ring_size - position % ring_size;
+            header = (volatile ring_entry_header*)ring;
+        }
+        const uint32_t size = header->size;
+        position += ring_entry_len(size);
+        return {(volatile char*)(header + 1), size};
+    }
+};
+
+/** In an entry that packs several messages, each message is preceded by its
+ * size, and padded so that the next size is aligned. */
+const uint32_t batch_entry_align = sizeof(uint32_t);
+
+/** Returns the space a message of the given size takes in a packed entry. */
+constexpr uint32_t batch_entry_len(uint32_t msg_size) {
+    return (sizeof(uint32_t) + msg_size + batch_entry_align - 1) & ~(batch_entry_align - 1);
+}
+
+/** Calls f(message, message_size) for each message packed into the size
+ * bytes at batch, in the order they were packed. */
+template <typename F>
+void for_each_batched_message(volatile char* batch, uint32_t size, F&& f) {
+    uint32_t pos = 0;
+    while(pos + sizeof(uint32_t) <= size) {
+        const uint32_t msg_size = *(volatile uint32_t*)(batch + pos);
+        f(batch + pos + sizeof(uint32_t), msg_size);
+        pos += batch_entry_len(msg_size);
+    }
+}
 }
@@ -5,14 +5,16 @@
 namespace sst {
 class multicast_sst : public SST<multicast_sst> {
 public:
-    SSTFieldVector<Message> slots;
+    SSTFieldVector<char> ring;
+    SSTFieldVector<uint64_t> ring_tail;
     SSTFieldVector<int64_t> num_received_sst;
     SSTField<bool> heartbeat;
-    multicast_sst(const SSTParams& parameters, uint32_t window_size, uint32_t num_senders)
+    multicast_sst(const SSTParams& parameters, uint32_t ring_size, uint32_t num_senders)
             : SST<multicast_sst>(this, parameters),
-              slots(window_size),
+              ring(ring_size),
+              ring_tail(1),
               num_received_sst(num_senders) {
-        SSTInit(slots, num_received_sst, heartbeat);
+        SSTInit(ring, ring_tail, num_received_sst, heartbeat);
     }
 };
 }
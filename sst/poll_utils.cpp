@@ -1,66 +1,250 @@
+#include <cassert>
+#include <chrono>
 #include <iostream>
-#include <numeric>
 
 #include "poll_utils.h"
 
 namespace sst {
 namespace util {
 
-std::vector<std::list<std::pair<int32_t, int32_t>>> PollingData::completion_entries;
-std::map<std::thread::id, uint32_t> PollingData::tid_to_index;
-std::vector<bool> PollingData::if_waiting;
-std::condition_variable PollingData::poll_cv;
-std::mutex PollingData::poll_mutex;
-
 //Single global instance, defined here
 PollingData polling_data;
 
-bool PollingData::check_waiting() {
-    return std::accumulate(if_waiting.begin(), if_waiting.end(), false, [](bool a, bool b) { return a || b; });
+completion_queue::completion_queue() : enqueue_pos(0), dequeue_pos(0) {
+    for(uint32_t i = 0; i < capacity; ++i) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * A cell whose sequence equals the position being pushed is free; once it
+ * has been written, its sequence becomes position + 1, marking it full.
+ */
+bool completion_queue::push(std::pair<int32_t, int32_t> ce) {
+    uint64_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    while(true) {
+        cell& c = cells[pos % capacity];
+        uint64_t sequence = c.sequence.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)sequence - (int64_t)pos;
+        if(diff == 0) {
+            if(enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                c.entry = ce;
+                c.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if(diff < 0) {
+            return false;
+        } else {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * A cell whose sequence equals the position being popped + 1 is full; once
+ * it has been read, its sequence becomes position + capacity, freeing it for
+ * the push that wraps around to it.
+ */
+std::experimental::optional<std::pair<int32_t, int32_t>> completion_queue::pop() {
+    uint64_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    while(true) {
+        cell& c = cells[pos % capacity];
+        uint64_t sequence = c.sequence.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)sequence - (int64_t)(pos + 1);
+        if(diff == 0) {
+            if(dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                auto ce = c.entry;
+                c.sequence.store(pos + capacity, std::memory_order_release);
+                return ce;
+            }
+        } else if(diff < 0) {
+            return {};
+        } else {
+            pos = dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+/** Holds the calling thread's index, and releases it when the thread exits. */
+struct thread_registration {
+    uint32_t index = PollingData::max_threads;
+
+    ~thread_registration() {
+        if(index < PollingData::max_threads) {
+            polling_data.release_index(index);
+        }
+    }
+};
+
+static thread_registration& my_registration() {
+    static thread_local thread_registration registration;
+    return registration;
+}
+
+static uint64_t steady_time_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+PollingData::PollingData() : num_operations(0), num_waiting(0) {
+    for(auto& operation : operations) {
+        operation = nullptr;
+    }
+    for(auto& slot : slots) {
+        slot = nullptr;
+    }
+}
+
+uint32_t PollingData::register_thread() {
+    for(uint32_t index = 0; index < max_threads; ++index) {
+        completion_slot* slot = slots[index];
+        if(!slot) {
+            std::unique_ptr<completion_slot> new_slot(new completion_slot);
+            new_slot->in_use = true;
+            if(slots[index].compare_exchange_strong(slot, new_slot.get())) {
+                new_slot.release();
+                return index;
+            }
+        }
+        bool in_use = false;
+        if(slot->in_use.compare_exchange_strong(in_use, true)) {
+            // drop anything delivered to the previous holder as it exited
+            while(slot->entries.pop()) {
+            }
+            return index;
+        }
+    }
+    std::cout << "More than " << max_threads << " threads are waiting for SST completions; "
+              << "sharing the last completion slot" << std::endl;
+    return max_threads - 1;
+}
+
+void PollingData::release_index(uint32_t index) {
+    completion_slot* slot = slots[index];
+    if(slot->waiting) {
+        slot->waiting = false;
+        num_waiting--;
+    }
+    slot->in_use = false;
+    while(slot->entries.pop()) {
+    }
 }
 
+auto PollingData::my_slot() -> completion_slot& {
+    return *slots[get_index(std::this_thread::get_id())];
+}
+
+/**
+ * @details
+ * Called by the polling thread, or by a transport that completes writes
+ * synchronously. An entry for an index that no thread holds any more is
+ * stale, and is dropped.
+ */
 void PollingData::insert_completion_entry(uint32_t index, std::pair<int32_t, int32_t> ce) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    completion_entries[index].push_back(ce);
+    if(index >= max_threads) {
+        if(index - max_threads >= max_operations) {
+            return;
+        }
+        pending_operation* operation = operations[index - max_threads];
+        if(!operation) {
+            return;
+        }
+        operation->on_completion(ce);
+        if(--operation->remaining == 0) {
+            operations[index - max_threads] = nullptr;
+            num_operations--;
+            delete operation;
+        }
+        return;
+    }
+    completion_slot* slot = index < max_threads ? slots[index].load() : nullptr;
+    if(!slot || !slot->in_use) {
+        return;
+    }
+    if(!slot->entries.push(ce)) {
+        std::cout << "Completion queue of thread index " << index << " is full, dropping a completion" << std::endl;
+    }
 }
 
 std::experimental::optional<std::pair<int32_t, int32_t>> PollingData::get_completion_entry(const std::thread::id id) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    auto index = tid_to_index[id];
-    if(completion_entries[index].empty()) {
-        return {};
-    }
-    auto ce = completion_entries[index].front();
-    completion_entries[index].pop_front();
-    return ce;
+    assert(id == std::this_thread::get_id());
+    return my_slot().entries.pop();
 }
 
 uint32_t PollingData::get_index(const std::thread::id id) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    if(tid_to_index.find(id) == tid_to_index.end()) {
-        completion_entries.push_back(std::list<std::pair<int32_t, int32_t>>());
-        tid_to_index[id] = completion_entries.size() - 1;
-        if_waiting.push_back(false);
+    assert(id == std::this_thread::get_id());
+    thread_registration& registration = my_registration();
+    if(registration.index == max_threads) {
+        registration.index = register_thread();
     }
-    return tid_to_index[id];
+    return registration.index;
 }
 
 void PollingData::set_waiting(const std::thread::id id) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    auto index = tid_to_index[id];
-    if_waiting[index] = true;
-    poll_cv.notify_all();
+    completion_slot& slot = my_slot();
+    if(slot.waiting) {
+        return;
+    }
+    slot.waiting = true;
+    if(num_waiting++ == 0) {
+        std::lock_guard<std::mutex> lk(poll_mutex);
+        poll_cv.notify_all();
+    }
 }
 
 void PollingData::reset_waiting(const std::thread::id id) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    auto index = tid_to_index[id];
-    if_waiting[index] = false;
+    completion_slot& slot = my_slot();
+    if(slot.waiting) {
+        slot.waiting = false;
+        num_waiting--;
+    }
 }
 
 void PollingData::wait_for_requests() {
     std::unique_lock<std::mutex> lk(poll_mutex);
-    poll_cv.wait(lk, check_waiting);
+    poll_cv.wait(lk, [this]() { return num_waiting > 0; });
+}
+
+/**
+ * @details
+ * The callbacks run on whichever thread delivers the entries: the polling
+ * thread for RDMA, or the posting thread itself for a transport that
+ * completes writes synchronously. They must therefore be short, and must not
+ * wait for other completions.
+ */
+uint32_t PollingData::register_operation(uint32_t num_entries, uint32_t timeout_ms,
+                                         std::function<void(std::pair<int32_t, int32_t>)> on_completion,
+                                         std::function<void()> on_timeout) {
+    std::unique_ptr<pending_operation> operation(new pending_operation{
+            num_entries, steady_time_ns() + (uint64_t)timeout_ms * 1000000,
+            std::move(on_completion), std::move(on_timeout)});
+    for(uint32_t i = 0; i < max_operations; ++i) {
+        pending_operation* expected = nullptr;
+        if(operations[i].compare_exchange_strong(expected, operation.get())) {
+            operation.release();
+            num_operations++;
+            return max_threads + i;
+        }
+    }
+    return invalid_index;
+}
+
+void PollingData::expire_operations() {
+    if(num_operations == 0) {
+        return;
+    }
+    const uint64_t now = steady_time_ns();
+    for(auto& slot : operations) {
+        pending_operation* operation = slot;
+        if(!operation || operation->deadline_ns > now) {
+            continue;
+        }
+        slot = nullptr;
+        num_operations--;
+        operation->on_timeout();
+        delete operation;
+    }
 }
 }
 }
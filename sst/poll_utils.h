@@ -1,36 +1,141 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <experimental/optional>
-#include <list>
-#include <map>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <thread>
-#include <vector>
+#include <utility>
 
 namespace sst {
 namespace util {
+
+/**
+ * A bounded, lock-free queue of completion entries. Any number of threads
+ * may push and pop concurrently; each cell carries a sequence number that
+ * tells pushers and poppers whose turn it is to use it.
+ */
+class completion_queue {
+public:
+    /** The most entries that can be waiting in one queue. */
+    static const uint32_t capacity = 512;
+
+private:
+    struct cell {
+        std::atomic<uint64_t> sequence;
+        std::pair<int32_t, int32_t> entry;
+    };
+    std::array<cell, capacity> cells;
+    std::atomic<uint64_t> enqueue_pos;
+    std::atomic<uint64_t> dequeue_pos;
+
+public:
+    completion_queue();
+
+    /** Adds an entry; returns false if the queue is full. */
+    bool push(std::pair<int32_t, int32_t> ce);
+
+    /** Removes the oldest entry, if there is one. */
+    std::experimental::optional<std::pair<int32_t, int32_t>> pop();
+};
+
+/**
+ * Delivers completion entries from the thread that polls for them to the
+ * threads that posted the operations. Each thread that posts operations with
+ * completions gets an index, used as the work request ID, which names a
+ * completion slot of its own; delivering and retrieving entries takes no
+ * lock. A thread's index is released, and reused, when the thread exits.
+ *
+ * Asynchronous operations get an index of their own instead, at or above
+ * max_threads, and have their entries handed to a callback by the thread
+ * that delivers them; the polling thread also expires them once their
+ * deadline passes.
+ */
 class PollingData {
-    static std::vector<std::list<std::pair<int32_t, int32_t>>> completion_entries;
-    static std::map<std::thread::id, uint32_t> tid_to_index;
-    static std::vector<bool> if_waiting;
-    static std::condition_variable poll_cv;
-    static std::mutex poll_mutex;
+public:
+    /** The most threads that can hold an index at the same time. */
+    static const uint32_t max_threads = 128;
+    /** The most asynchronous operations that can be pending at the same time. */
+    static const uint32_t max_operations = 1024;
+    /** Returned by register_operation when no index is free. */
+    static const uint32_t invalid_index = UINT32_MAX;
+
+private:
+    struct pending_operation {
+        /** The number of entries still expected. */
+        uint32_t remaining;
+        /** When to give up on the remaining entries, in steady_clock nanoseconds. */
+        uint64_t deadline_ns;
+        std::function<void(std::pair<int32_t, int32_t>)> on_completion;
+        std::function<void()> on_timeout;
+    };
+    /** Pending operations, by index - max_threads. */
+    std::array<std::atomic<pending_operation*>, max_operations> operations;
+    /** The number of pending operations. */
+    std::atomic<uint32_t> num_operations;
+
+    struct completion_slot {
+        /** Whether a thread currently holds this slot's index. */
+        std::atomic<bool> in_use{false};
+        /** Whether that thread is waiting for completions. */
+        std::atomic<bool> waiting{false};
+        completion_queue entries;
+    };
+    /** Slots by index, allocated the first time the index is handed out.
+     * They are never freed, since the polling thread is detached and may
+     * still deliver entries while the process exits. */
+    std::array<std::atomic<completion_slot*>, max_threads> slots;
+    /** The number of threads waiting for completions. */
+    std::atomic<uint32_t> num_waiting;
+    std::condition_variable poll_cv;
+    std::mutex poll_mutex;
 
-    static bool check_waiting();
+    /** Claims a free index for the calling thread. */
+    uint32_t register_thread();
+    /** Returns an index to the free pool, dropping any undelivered entries. */
+    void release_index(uint32_t index);
+    /** Returns the slot of the calling thread. */
+    completion_slot& my_slot();
+
+    friend struct thread_registration;
 
 public:
+    PollingData();
+
+    /** Delivers a completion entry to the thread holding the given index. */
     void insert_completion_entry(uint32_t index, std::pair<int32_t, int32_t> ce);
 
+    /** Retrieves the next completion entry for the calling thread, whose ID must be id. */
     std::experimental::optional<std::pair<int32_t, int32_t>> get_completion_entry(const std::thread::id id);
 
+    /** Returns the index of the calling thread, whose ID must be id. */
     uint32_t get_index(const std::thread::id id);
 
     void set_waiting(const std::thread::id id);
 
     void reset_waiting(const std::thread::id id);
 
+    /** Blocks until some thread is waiting for completions. */
     void wait_for_requests();
+
+    /**
+     * Registers an asynchronous operation that expects num_entries
+     * completion entries, and returns the index to post its work requests
+     * with, or invalid_index if too many operations are pending. on_completion
+     * is called with each entry, and on_timeout is called instead if they
+     * have not all arrived within timeout_ms; neither is called after that.
+     */
+    uint32_t register_operation(uint32_t num_entries, uint32_t timeout_ms,
+                                std::function<void(std::pair<int32_t, int32_t>)> on_completion,
+                                std::function<void()> on_timeout);
+
+    /** Times out the pending operations whose deadline has passed; called
+     * regularly by the polling thread. */
+    void expire_operations();
 };
 
 //There is one global instance of PollingData
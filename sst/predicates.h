@@ -1,10 +1,15 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <functional>
 #include <list>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include "sst.h"
 
@@ -25,45 +30,186 @@ enum class PredicateType {
     TRANSITION
 };
 
+/**
+ * Describes part of the table that a predicate reads: size bytes starting at
+ * offset within each of the listed rows. Offsets are computed the same way as
+ * for SST::put, relative to the start of a row.
+ */
+struct predicate_input {
+    long long int offset;
+    long long int size;
+    /** Row indexes to watch; an empty list means every row. */
+    std::vector<uint32_t> rows;
+
+    bool operator==(const predicate_input& other) const {
+        return offset == other.offset && size == other.size && rows == other.rows;
+    }
+};
+
 template <class DerivedSST>
 class Predicates {
     using pred = std::function<bool(const DerivedSST&)>;
     using trig = std::function<void(DerivedSST&)>;
-    using pred_list = std::list<std::unique_ptr<std::pair<pred, std::shared_ptr<trig>>>>;
-    /** Predicate list for one-time predicates. */
-    pred_list one_time_predicates;
-    /** Predicate list for recurrent predicates */
-    pred_list recurrent_predicates;
-    /** Predicate list for transition predicates */
-    pred_list transition_predicates;
-    /** Contains one entry for every predicate in `transition_predicates`, in parallel. */
-    std::list<bool> transition_predicate_states;
+
+    /**
+     * A registered predicate, its trigger, and the state used to decide
+     * whether it needs to be evaluated again. Once an entry has been handed
+     * to its group's evaluation thread, only that thread touches anything
+     * but removed; other threads remove an entry by setting removed, and
+     * the evaluation thread unlinks it from its list on the next pass.
+     */
+    struct predicate_entry {
+        pred predicate;
+        trig trigger;
+        const PredicateType type;
+        /** The ranges of the table the predicate declared as its inputs. */
+        const std::vector<predicate_input> declared_inputs;
+        /** Indexes into watched_inputs of declared_inputs. Empty if the
+         * predicate did not declare its inputs, in which case it is
+         * evaluated on every pass. */
+        std::vector<uint32_t> inputs;
+        /** Whether the predicate has not been evaluated since it was inserted. */
+        bool is_new;
+        /** The result of the last evaluation of the predicate. */
+        bool last_result;
+        /** Set by Predicates::remove. */
+        std::atomic<bool> removed;
+        /** The group's clear_epoch when the predicate was inserted. */
+        const uint64_t clear_epoch;
+
+        predicate_entry(pred predicate, trig trigger, PredicateType type,
+                        const std::vector<predicate_input>& declared_inputs, uint64_t clear_epoch)
+                : predicate(predicate),
+                  trigger(trigger),
+                  type(type),
+                  declared_inputs(declared_inputs),
+                  is_new(true),
+                  last_result(false),
+                  removed(false),
+                  clear_epoch(clear_epoch) {}
+    };
+
+    /** A range of the table watched on behalf of one or more predicates. */
+    struct watched_input {
+        predicate_input range;
+        /** The contents of the range in each watched row at the previous check. */
+        std::vector<char> last_seen;
+        /** Whether the range differed from last_seen at the latest check. */
+        bool changed;
+        /** The number of predicates that read the range; unused ranges are
+         * not checked, and their slots are reused. */
+        uint32_t num_readers;
+    };
+
+    /** A newly inserted predicate, waiting to be adopted by the evaluation thread. */
+    struct pending_entry {
+        std::shared_ptr<predicate_entry> entry;
+        pending_entry* next;
+    };
+
+    using pred_list = std::list<std::shared_ptr<predicate_entry>>;
+
+    /**
+     * A set of predicates that are always evaluated, in order, by the same
+     * evaluation thread. Predicates in different groups may be evaluated
+     * and have their triggers run concurrently.
+     *
+     * The predicate lists and watched_inputs belong to the evaluation
+     * thread, so it evaluates them without taking any lock. Other threads
+     * only push new predicates onto pending_inserts, set an entry's removed
+     * flag, or advance clear_epoch, none of which can block it.
+     */
+    struct predicate_group {
+        /** Predicate list for one-time predicates. */
+        pred_list one_time_predicates;
+        /** Predicate list for recurrent predicates */
+        pred_list recurrent_predicates;
+        /** Predicate list for transition predicates */
+        pred_list transition_predicates;
+        /** Every distinct range declared as an input by a predicate in this group. */
+        std::vector<watched_input> watched_inputs;
+        /** Predicates inserted since the last pass, most recent first. */
+        std::atomic<pending_entry*> pending_inserts{nullptr};
+        /** Advanced by Predicates::clear; every predicate inserted before
+         * the current epoch is dead. */
+        std::atomic<uint64_t> clear_epoch{0};
+        /** Incremented before and after the evaluation thread evaluates a
+         * predicate and runs its trigger, so it is odd while one of this
+         * group's predicates or triggers may be running. */
+        std::atomic<uint64_t> trigger_epoch{0};
+        /** The thread running one of this group's predicates or triggers, if any. */
+        std::atomic<std::thread::id> trigger_thread{std::thread::id()};
+
+        ~predicate_group();
+
+        /** Moves the pending predicates to the end of their lists, in
+         * insertion order. Must only be called by the evaluation thread. */
+        void adopt_pending_inserts();
+
+        /** Returns the index of the watched range for input, adding it if needed. */
+        uint32_t watch(const predicate_input& input);
+
+        /** Returns whether a predicate has been removed, directly or by clear(). */
+        bool is_dead(const predicate_entry& entry) const {
+            return entry.removed || entry.clear_epoch != clear_epoch;
+        }
+
+        /** Unlinks a dead predicate from its list, releases its functions and
+         * inputs, and returns the position after it. */
+        typename pred_list::iterator unlink(pred_list& list, typename pred_list::iterator it);
+
+        /** Decides whether a predicate must be evaluated in the current pass;
+         * watched_inputs must have been checked for changes first. */
+        bool needs_evaluation(const predicate_entry& entry) const;
+
+        /** Waits until no trigger of this group is running, unless it is the
+         * calling thread that is running one. */
+        void wait_for_trigger() const;
+    };
+
+    /** All the predicate groups, by ID. Groups are created the first time a
+     * predicate is inserted in them, and are never destroyed. */
+    std::map<uint32_t, std::unique_ptr<predicate_group>> groups;
+    /** Protects groups. */
+    std::mutex groups_mutex;
+    /** Incremented every time a group is created. */
+    std::atomic<uint64_t> groups_version{0};
     // SST needs to read these predicate lists directly
     friend class SST<DerivedSST>;
 
-    std::mutex predicate_mutex;
+    /** Called after every insertion, so that SST can wake its predicate
+     * evaluation threads. */
+    std::function<void()> insert_callback;
+
+    /** Returns the group with the given ID, creating it if needed. */
+    predicate_group& get_group(uint32_t group_id);
+
+    /** Lists the groups evaluated by one of num_threads evaluation threads:
+     * those whose IDs are equal to thread_index modulo num_threads. */
+    void get_groups_for_thread(uint32_t thread_index, uint32_t num_threads,
+                               std::vector<predicate_group*>& thread_groups);
 
 public:
     class pred_handle {
         bool is_valid;
-        typename pred_list::iterator iter;
-        PredicateType type;
+        std::shared_ptr<predicate_entry> entry;
+        predicate_group* group;
         friend class Predicates;
 
     public:
-        pred_handle() : is_valid(false), type(PredicateType::ONE_TIME) {}
-        pred_handle(typename pred_list::iterator iter, PredicateType type)
-                : is_valid{true}, iter{iter}, type{type} {}
+        pred_handle() : is_valid(false), group(nullptr) {}
+        pred_handle(std::shared_ptr<predicate_entry> entry, predicate_group* group)
+                : is_valid{true}, entry{std::move(entry)}, group{group} {}
         pred_handle(pred_handle&) = delete;
         pred_handle(pred_handle&& other)
-                : pred_handle(std::move(other.iter), other.type) {
+                : is_valid{other.is_valid}, entry{std::move(other.entry)}, group{other.group} {
             other.is_valid = false;
         }
         pred_handle& operator=(pred_handle&) = delete;
         pred_handle& operator=(pred_handle&& other) {
-            iter = std::move(other.iter);
-            type = other.type;
-            is_valid = true;
+            entry = std::move(other.entry);
+            group = other.group;
+            is_valid = other.is_valid;
             other.is_valid = false;
             return *this;
         }
@@ -71,7 +217,16 @@ public:
 
     /** Inserts a single (predicate, trigger) pair to the appropriate predicate list. */
     pred_handle insert(pred predicate, trig trigger,
-                       PredicateType type = PredicateType::ONE_TIME);
+                       PredicateType type = PredicateType::ONE_TIME) {
+        return insert(predicate, trigger, type, {});
+    }
+
+    /** Inserts a (predicate, trigger) pair whose predicate reads nothing but
+     * the given ranges of the table, so that it is only re-evaluated after
+     * one of them changes, into the given predicate group. */
+    pred_handle insert(pred predicate, trig trigger, PredicateType type,
+                       const std::vector<predicate_input>& inputs,
+                       uint32_t group_id = 0);
 
     /** Inserts a predicate with a list of triggers (which will be run in
      * sequence) to the appropriate predicate list. */
@@ -92,54 +247,212 @@ public:
 };
 
 /**
- * This is a convenience method for when the predicate has only one trigger; it
- * automatically chooses the right list based on the predicate type. To insert
- * a predicate with multiple triggers, use std::list::insert() directly on the
- * appropriate predicate list member.
+ * This automatically chooses the right list based on the predicate type. To
+ * insert a predicate with multiple triggers, use the overload that takes a
+ * list of triggers. The predicate is evaluated from the next pass over its
+ * group onwards.
  * @param predicate The predicate to insert.
  * @param trigger The trigger to execute when the predicate is true.
- * @param type The type of predicate being inserted; default is
- * PredicateType::ONE_TIME
+ * @param type The type of predicate being inserted
+ * @param inputs The ranges of the table the predicate reads. The predicate
+ * must depend on nothing else, apart from state that only its own trigger
+ * changes; if it is empty, the predicate is evaluated on every pass.
+ * @param group_id The group to insert the predicate in. Predicates in the
+ * same group are evaluated in insertion order by a single thread; group 0
+ * is the default.
+ */
+template <class DerivedSST>
+auto Predicates<DerivedSST>::insert(pred predicate, trig trigger, PredicateType type,
+                                    const std::vector<predicate_input>& inputs,
+                                    uint32_t group_id) -> pred_handle {
+    predicate_group& group = get_group(group_id);
+    auto entry = std::make_shared<predicate_entry>(predicate, trigger, type, inputs, group.clear_epoch);
+    pred_handle handle(entry, &group);
+    pending_entry* pending = new pending_entry{std::move(entry), group.pending_inserts};
+    while(!group.pending_inserts.compare_exchange_weak(pending->next, pending)) {
+    }
+    // the new predicate may already be true, so don't leave it waiting on an idle evaluator
+    if(insert_callback) {
+        insert_callback();
+    }
+    return handle;
+}
+
+template <class DerivedSST>
+auto Predicates<DerivedSST>::get_group(uint32_t group_id) -> predicate_group& {
+    std::lock_guard<std::mutex> lock(groups_mutex);
+    auto& group = groups[group_id];
+    if(!group) {
+        group = std::make_unique<predicate_group>();
+        groups_version++;
+    }
+    return *group;
+}
+
+template <class DerivedSST>
+void Predicates<DerivedSST>::get_groups_for_thread(uint32_t thread_index, uint32_t num_threads,
+                                                   std::vector<predicate_group*>& thread_groups) {
+    std::lock_guard<std::mutex> lock(groups_mutex);
+    thread_groups.clear();
+    for(auto& id_group : groups) {
+        if(id_group.first % num_threads == thread_index) {
+            thread_groups.push_back(id_group.second.get());
+        }
+    }
+}
+
+template <class DerivedSST>
+Predicates<DerivedSST>::predicate_group::~predicate_group() {
+    pending_entry* pending = pending_inserts.exchange(nullptr);
+    while(pending) {
+        pending_entry* next = pending->next;
+        delete pending;
+        pending = next;
+    }
+}
+
+template <class DerivedSST>
+void Predicates<DerivedSST>::predicate_group::adopt_pending_inserts() {
+    pending_entry* pending = pending_inserts.exchange(nullptr);
+    // the stack holds the most recent insertion first
+    pending_entry* oldest_first = nullptr;
+    while(pending) {
+        pending_entry* next = pending->next;
+        pending->next = oldest_first;
+        oldest_first = pending;
+        pending = next;
+    }
+    while(oldest_first) {
+        pending_entry* next = oldest_first->next;
+        auto& entry = oldest_first->entry;
+        if(!is_dead(*entry)) {
+            for(const auto& input : entry->declared_inputs) {
+                entry->inputs.push_back(watch(input));
+            }
+            if(entry->type == PredicateType::ONE_TIME) {
+                one_time_predicates.push_back(std::move(entry));
+            } else if(entry->type == PredicateType::RECURRENT) {
+                recurrent_predicates.push_back(std::move(entry));
+            } else {
+                transition_predicates.push_back(std::move(entry));
+            }
+        }
+        delete oldest_first;
+        oldest_first = next;
+    }
+}
+
+template <class DerivedSST>
+uint32_t Predicates<DerivedSST>::predicate_group::watch(const predicate_input& input) {
+    for(uint32_t i = 0; i < watched_inputs.size(); ++i) {
+        if(watched_inputs[i].num_readers > 0 && watched_inputs[i].range == input) {
+            ++watched_inputs[i].num_readers;
+            return i;
+        }
+    }
+    // a new range counts as changed until its contents have been recorded
+    for(uint32_t i = 0; i < watched_inputs.size(); ++i) {
+        if(watched_inputs[i].num_readers == 0) {
+            watched_inputs[i] = {input, {}, true, 1};
+            return i;
+        }
+    }
+    watched_inputs.push_back({input, {}, true, 1});
+    return watched_inputs.size() - 1;
+}
+
+/**
+ * The entry itself is freed once its handle has also been destroyed or
+ * removed; until then the handle can still safely set its removed flag.
+ */
+template <class DerivedSST>
+auto Predicates<DerivedSST>::predicate_group::unlink(pred_list& list, typename pred_list::iterator it)
+        -> typename pred_list::iterator {
+    predicate_entry& entry = **it;
+    for(auto index : entry.inputs) {
+        if(--watched_inputs[index].num_readers == 0) {
+            watched_inputs[index].last_seen.clear();
+        }
+    }
+    entry.inputs.clear();
+    entry.predicate = nullptr;
+    entry.trigger = nullptr;
+    return list.erase(it);
+}
+
+/**
+ * A predicate is evaluated if it is new, if it did not declare its inputs,
+ * or if one of its inputs changed since the previous pass. A recurrent
+ * predicate that was true is evaluated again regardless, since its trigger
+ * must keep firing for as long as it stays true.
+ */
+template <class DerivedSST>
+bool Predicates<DerivedSST>::predicate_group::needs_evaluation(const predicate_entry& entry) const {
+    if(entry.is_new || entry.inputs.empty()) {
+        return true;
+    }
+    if(entry.type == PredicateType::RECURRENT && entry.last_result) {
+        return true;
+    }
+    for(auto index : entry.inputs) {
+        if(watched_inputs[index].changed) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * The evaluation thread makes trigger_epoch odd before it checks whether a
+ * predicate is dead, and keeps it odd until the predicate and its trigger
+ * have run, so a predicate marked dead before this reads an even
+ * trigger_epoch can no longer be evaluated or have its trigger run.
  */
 template <class DerivedSST>
-auto Predicates<DerivedSST>::insert(pred predicate, trig trigger, PredicateType type) -> pred_handle {
-    std::lock_guard<std::mutex> lock(predicate_mutex);
-    if(type == PredicateType::ONE_TIME) {
-        one_time_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
-                predicate, std::make_shared<trig>(trigger)));
-        return pred_handle(--one_time_predicates.end(), type);
-    } else if(type == PredicateType::RECURRENT) {
-        recurrent_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
-                predicate, std::make_shared<trig>(trigger)));
-        return pred_handle(--recurrent_predicates.end(), type);
-    } else {
-        transition_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
-                predicate, std::make_shared<trig>(trigger)));
-        transition_predicate_states.push_back(false);
-        return pred_handle(--transition_predicates.end(), type);
+void Predicates<DerivedSST>::predicate_group::wait_for_trigger() const {
+    if(trigger_thread.load() == std::this_thread::get_id()) {
+        return;
+    }
+    const uint64_t epoch = trigger_epoch.load();
+    if(epoch % 2 == 0) {
+        return;
+    }
+    while(trigger_epoch.load() == epoch) {
+        std::this_thread::yield();
     }
 }
 
+/**
+ * Once this returns, neither the predicate nor its trigger is running on
+ * another evaluation thread, and neither will run again, so the state they
+ * capture may be freed. A trigger may remove predicates of its own group,
+ * but two triggers in different groups must not remove each other's
+ * predicates.
+ */
 template <class DerivedSST>
 void Predicates<DerivedSST>::remove(pred_handle& handle) {
-    std::lock_guard<std::mutex> lock(predicate_mutex);
     if(!handle.is_valid) {
         return;
     }
-    handle.iter->reset();
+    handle.entry->removed = true;
+    handle.entry.reset();
     handle.is_valid = false;
+    handle.group->wait_for_trigger();
 }
 
 template <class DerivedSST>
 void Predicates<DerivedSST>::clear() {
-    std::lock_guard<std::mutex> lock(predicate_mutex);
-    using ptr_to_pred = std::unique_ptr<std::pair<pred, std::shared_ptr<trig>>>;
-    std::for_each(one_time_predicates.begin(), one_time_predicates.end(),
-                  [](ptr_to_pred& ptr) { ptr.reset(); });
-    std::for_each(recurrent_predicates.begin(), recurrent_predicates.end(),
-                  [](ptr_to_pred& ptr) { ptr.reset(); });
-    std::for_each(transition_predicates.begin(), transition_predicates.end(),
-                  [](ptr_to_pred& ptr) { ptr.reset(); });
+    std::vector<predicate_group*> all_groups;
+    {
+        std::lock_guard<std::mutex> groups_lock(groups_mutex);
+        for(auto& id_group : groups) {
+            all_groups.push_back(id_group.second.get());
+        }
+    }
+    for(auto group : all_groups) {
+        group->clear_epoch++;
+        group->wait_for_trigger();
+    }
 }
 
 } /* namespace sst */
@@ -0,0 +1,247 @@
+/**
+ * @file shm.cpp
+ * Contains the implementation of the shared-memory transport layer of %SST.
+ */
+#include <atomic>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <signal.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "derecho/connection_manager.h"
+#include "derecho/derecho_ports.h"
+#include "poll_utils.h"
+#include "shm.h"
+#include "verbs.h"
+
+using std::cout;
+using std::endl;
+
+namespace sst {
+
+/** The TCP connections used for setup and synchronization, shared with verbs.cpp. */
+extern tcp::tcp_connections* sst_connections;
+
+/** Describes a segment created by shm_allocate_rows. */
+struct shm_segment {
+    std::string name;
+    size_t size;
+};
+
+/** All segments created by this process, keyed by their local address. */
+static std::map<char*, shm_segment> local_segments;
+/** Protects local_segments. */
+static std::mutex segments_mutex;
+/** Used to give every segment created by this process a unique name. */
+static std::atomic<uint32_t> segment_counter{0};
+/** ID of this node, used in segment names. */
+static uint32_t my_node_rank;
+
+/**
+ * Copies bytes in increasing address order, so that a reader polling the
+ * destination observes them in the same order in which an RDMA write
+ * would have delivered them: a flag at the end of a written range is not
+ * visible before the data preceding it.
+ */
+static void ordered_copy(volatile char* dst, const char* src, size_t size) {
+    std::atomic_thread_fence(std::memory_order_release);
+    size_t i = 0;
+    if(((uintptr_t)dst % sizeof(uint64_t)) == ((uintptr_t)src % sizeof(uint64_t))) {
+        for(; i < size && ((uintptr_t)(dst + i) % sizeof(uint64_t)) != 0; ++i) {
+            dst[i] = src[i];
+        }
+        for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+            *(volatile uint64_t*)(dst + i) = *(const uint64_t*)(src + i);
+        }
+    }
+    for(; i < size; ++i) {
+        dst[i] = src[i];
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+/**
+ * Maps the table of the remote node into this process. write_addr must lie
+ * within memory returned by shm_allocate_rows.
+ *
+ * @param r_index The node rank of the remote node to connect to.
+ * @param write_addr A pointer to the memory that the remote node will write
+ * its row into.
+ * @param read_addr A pointer to the local row, which will be copied into the
+ * remote node's table.
+ * @param size_w The size of the write buffer (in bytes).
+ * @param size_r The size of the read buffer (in bytes).
+ */
+shm_resources::shm_resources(int r_index, char* write_addr, char* read_addr, int size_w,
+                             int size_r)
+        : remote_segment(nullptr),
+          remote_segment_size(0),
+          remote_pid(0),
+          remote_index(r_index),
+          write_buf(write_addr),
+          read_buf(read_addr),
+          remote_buf(nullptr) {
+    struct shm_con_data_t local_con_data;
+    struct shm_con_data_t remote_con_data;
+    memset(&local_con_data, 0, sizeof(local_con_data));
+    {
+        std::lock_guard<std::mutex> lock(segments_mutex);
+        auto it = local_segments.upper_bound(write_buf);
+        if(it == local_segments.begin()) {
+            cout << "Write address is not in a shared memory segment" << endl;
+        } else {
+            --it;
+            strncpy(local_con_data.segment_name, it->second.name.c_str(), SHM_NAME_LEN - 1);
+            local_con_data.segment_size = it->second.size;
+            local_con_data.offset = write_buf - it->first;
+        }
+    }
+    local_con_data.pid = getpid();
+
+    bool success = sst_connections->exchange(remote_index, local_con_data, remote_con_data);
+    if(!success) {
+        cout << "Could not exchange shared memory segment names with node " << r_index << endl;
+    }
+    remote_pid = remote_con_data.pid;
+    remote_segment_size = remote_con_data.segment_size;
+
+    int fd = shm_open(remote_con_data.segment_name, O_RDWR, 0);
+    if(fd < 0) {
+        cout << "Could not open shared memory segment " << remote_con_data.segment_name
+             << ", error code is: " << errno << endl;
+    } else {
+        void* addr = mmap(nullptr, remote_segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if(addr == MAP_FAILED) {
+            cout << "Could not map shared memory segment " << remote_con_data.segment_name
+                 << ", error code is: " << errno << endl;
+        } else {
+            remote_segment = (char*)addr;
+            remote_buf = remote_segment + remote_con_data.offset;
+        }
+    }
+
+    // make sure both sides have mapped each other before any writes happen
+    success = sync(remote_index);
+    if(!success) {
+        cout << "Could not sync after mapping shared memory segment" << endl;
+    }
+    cout << "Established shared memory connection with node " << r_index << endl;
+}
+
+shm_resources::~shm_resources() {
+    if(remote_segment) {
+        munmap(remote_segment, remote_segment_size);
+    }
+}
+
+uint32_t shm_resources::get_completion_key() const {
+    return remote_index;
+}
+
+void shm_resources::write(const long long int offset, const long long int size) {
+    if(!remote_buf) {
+        cout << "Could not write to shared memory, remote_index is " << remote_index << endl;
+        return;
+    }
+    ordered_copy(remote_buf + offset, read_buf + offset, size);
+}
+
+/**
+ * @param offset The offset, in bytes, of the remote row at which to start
+ * writing.
+ * @param size The number of bytes to write from the local row.
+ */
+void shm_resources::post_remote_write(const uint32_t id, const long long int offset, const long long int size) {
+    write(offset, size);
+}
+
+/**
+ * Since the copy is synchronous, the completion entry is reported right
+ * away; it is a failure if the remote process no longer exists.
+ */
+void shm_resources::post_remote_write_with_completion(const uint32_t id, const long long int offset, const long long int size) {
+    int result = 1;
+    if(kill(remote_pid, 0) < 0 && errno == ESRCH) {
+        result = -1;
+    } else {
+        write(offset, size);
+    }
+    util::polling_data.insert_completion_entry(id, {remote_index, result});
+}
+
+/**
+ * @details
+ * Each segment is sized to a whole number of pages and starts out zeroed.
+ */
+char* shm_allocate_rows(size_t size) {
+    std::string name = "/sst_" + std::to_string(my_node_rank) + "_" + std::to_string(getpid())
+                       + "_" + std::to_string(segment_counter++);
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+    if(fd < 0) {
+        cout << "Could not create shared memory segment " << name << ", error code is: " << errno << endl;
+        return nullptr;
+    }
+    if(ftruncate(fd, size) < 0) {
+        cout << "Could not resize shared memory segment " << name << ", error code is: " << errno << endl;
+    }
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED) {
+        cout << "Could not map shared memory segment " << name << ", error code is: " << errno << endl;
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(segments_mutex);
+    local_segments[(char*)addr] = {name, size};
+    return (char*)addr;
+}
+
+void shm_free_rows(char* rows) {
+    std::lock_guard<std::mutex> lock(segments_mutex);
+    auto it = local_segments.find(rows);
+    if(it == local_segments.end()) {
+        return;
+    }
+    munmap(rows, it->second.size);
+    shm_unlink(it->second.name.c_str());
+    local_segments.erase(it);
+}
+
+/**
+ * @details
+ * This must be called before creating or using any SST instance. Since all
+ * the nodes share one host, each node listens for TCP connections on its own
+ * port, offset from the SST port by its node ID.
+ */
+void shm_initialize(const std::map<uint32_t, std::string>& ip_addrs, uint32_t node_rank) {
+    my_node_rank = node_rank;
+    sst_connections = new tcp::tcp_connections(node_rank, ip_addrs, derecho::sst_tcp_port, true);
+    set_transport_type(TransportType::SHARED_MEMORY);
+
+    cout << "Initialized shared memory transport" << endl;
+}
+
+/**
+ * @details
+ * This unlinks any segments still in use, so it should only be called once
+ * all SST instances have been destroyed.
+ */
+void shm_destroy() {
+    std::lock_guard<std::mutex> lock(segments_mutex);
+    for(auto& segment : local_segments) {
+        munmap(segment.first, segment.second.size);
+        shm_unlink(segment.second.name.c_str());
+    }
+    local_segments.clear();
+
+    cout << "Shutting down" << endl;
+}
+
+}  // namespace sst
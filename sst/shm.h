@@ -0,0 +1,84 @@
+#pragma once
+
+/**
+ * @file shm.h
+ * Contains declarations for the shared-memory row transport, which lets
+ * several processes on a single host run a real SST without an RDMA NIC.
+ * Every SST table is allocated in a POSIX shared-memory segment, and a
+ * remote write is a store into the mapping of the remote node's segment.
+ */
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <sys/types.h>
+
+#include "transport.h"
+
+namespace sst {
+
+/** Maximum length of a shared-memory segment name, including the terminator. */
+const int SHM_NAME_LEN = 64;
+
+/** Structure to exchange the data needed to map a remote node's table. */
+struct shm_con_data_t {
+    /** Name of the segment holding the remote table */
+    char segment_name[SHM_NAME_LEN];
+    /** Total size of that segment */
+    uint64_t segment_size;
+    /** Offset within the segment of the row this node writes to */
+    uint64_t offset;
+    /** Process ID of the owner, used to detect that it has exited */
+    int32_t pid;
+} __attribute__((packed));
+
+/**
+ * Represents the mapping of a single remote node's table, through which
+ * the local row is written into that node's copy of it.
+ */
+class shm_resources : public row_transport {
+private:
+    /** Start of the local mapping of the remote segment. */
+    char* remote_segment;
+    /** Size of the remote segment. */
+    size_t remote_segment_size;
+    /** Process ID of the remote node. */
+    pid_t remote_pid;
+
+    /** Copies size bytes at offset from read_buf into the remote row. */
+    void write(const long long int offset, const long long int size);
+
+public:
+    /** Index of the remote node. */
+    int remote_index;
+    /** Pointer to the memory that the remote node writes into. */
+    char* write_buf;
+    /** Pointer to the local memory whose contents are written remotely. */
+    char* read_buf;
+    /** Pointer to the remote node's copy of the local row. */
+    volatile char* remote_buf;
+
+    /** Constructor; exchanges segment names with the remote node and maps
+     * its segment. */
+    shm_resources(int r_index, char* write_addr, char* read_addr, int size_w,
+                  int size_r);
+    /** Unmaps the remote segment. */
+    virtual ~shm_resources();
+
+    uint32_t get_completion_key() const;
+    void post_remote_write(const uint32_t id, const long long int offset, const long long int size);
+    void post_remote_write_with_completion(const uint32_t id, const long long int offset, const long long int size);
+};
+
+/** Initializes the shared-memory transport and makes it the one new SST
+ * instances use. Must be called instead of verbs_initialize. */
+void shm_initialize(const std::map<uint32_t, std::string>& ip_addrs,
+                    uint32_t node_rank);
+/** Creates a shared-memory segment large enough for an SST table. */
+char* shm_allocate_rows(size_t size);
+/** Unmaps and unlinks a segment created by shm_allocate_rows. */
+void shm_free_rows(char* rows);
+/** Destroys the global shared-memory transport state. */
+void shm_destroy();
+
+}  // namespace sst
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <bitset>
 #include <cassert>
@@ -16,7 +17,9 @@
 #include <thread>
 #include <vector>
 
+#include "histogram.h"
 #include "predicates.h"
+#include "transport.h"
 #include "verbs.h"
 
 using sst::resources;
@@ -25,10 +28,31 @@ namespace sst {
 
 const int alignTo = sizeof(long);
 
+/** Rounds len up to a multiple of alignTo, and to at least alignTo. */
 constexpr int padded_len(const int& len) {
-    return (len < alignTo) ? alignTo : (len + alignTo) | (alignTo - 1);
+    return (len < alignTo) ? alignTo : (len + alignTo - 1) & ~(alignTo - 1);
 }
 
+/** Rounds len up to a multiple of cache_line_size. */
+constexpr int cache_line_padded_len(const int& len) {
+    return (len + cache_line_size - 1) & ~(cache_line_size - 1);
+}
+
+/** How long, in microseconds, the predicate evaluation thread keeps spinning
+ * after the last predicate fired before it starts yielding or blocking. */
+const int idle_spin_time_us = 1000;
+/** The longest, in microseconds, the predicate evaluation thread blocks at a
+ * time. Remote writes cannot wake it, so this bounds how late it notices them. */
+const int max_block_time_us = 1000;
+
+/** Deferred puts to the same row whose byte ranges are at most this far
+ * apart are merged into a single remote write. */
+const int put_coalesce_gap = 64;
+
+/** How long, in milliseconds, to wait for the completion of a remote write
+ * before reporting its destination as failed. */
+const int completion_timeout_ms = 2000;
+
 /** Internal helper class, never exposed to the client. */
 class _SSTField {
 public:
@@ -115,8 +139,239 @@ public:
     }
 };
 
+/**
+ * Clients should use instances of this class to declare vector-like fields
+ * whose elements are divided into blocks, such as a field with one or more
+ * entries per subgroup. The number of elements in each block is fixed at
+ * construction. Elements are accessed just like those of an SSTFieldVector,
+ * but when the SST uses the RowLayout::CACHE_LINE_BLOCKS layout, each block
+ * is stored next to the same block of the other SSTFieldBlockVectors rather
+ * than next to the other elements of this field, so only the elements within
+ * one block are guaranteed to be contiguous.
+ */
+template <typename T>
+class SSTFieldBlockVector : public _SSTField {
+public:
+    /** The elements of one row of the field, as returned by operator[]. */
+    class row_elements {
+        volatile char* row_base;
+        const int* element_offsets;
+
+    public:
+        row_elements(volatile char* row_base, const int* element_offsets)
+                : row_base(row_base), element_offsets(element_offsets) {}
+
+        template <typename Index>
+        volatile T& operator[](Index idx) const {
+            return *(volatile T*)(row_base + element_offsets[idx]);
+        }
+
+        /** Returns a pointer to an element; pointer arithmetic on the result
+         * is valid only within that element's block. */
+        template <typename Index>
+        volatile T* operator+(Index idx) const {
+            return &(*this)[idx];
+        }
+    };
+
+private:
+    /** The number of elements in each block. */
+    const std::vector<uint32_t> block_lengths;
+    /** The index of the first element of each block. */
+    std::vector<uint32_t> block_starts;
+    /** For each element, its offset from base within any row. */
+    std::vector<int> element_offsets;
+
+public:
+    using _SSTField::base;
+    using _SSTField::rowLen;
+    using _SSTField::field_len;
+
+    SSTFieldBlockVector(const std::vector<uint32_t>& block_lengths)
+            : _SSTField(std::accumulate(block_lengths.begin(), block_lengths.end(), 0u) * sizeof(T)),
+              block_lengths(block_lengths),
+              element_offsets(size()) {
+        uint32_t start = 0;
+        for(auto length : block_lengths) {
+            block_starts.push_back(start);
+            start += length;
+        }
+        for(std::size_t i = 0; i < element_offsets.size(); ++i) {
+            element_offsets[i] = i * sizeof(T);
+        }
+    }
+
+    row_elements operator[](const int& idx) const {
+        return row_elements(base + idx * rowLen, element_offsets.data());
+    }
+
+    /** Returns the total number of elements, in all blocks. */
+    size_t size() const { return field_len / sizeof(T); }
+
+    /** Returns the number of blocks the elements are divided into. */
+    uint32_t num_blocks() const { return block_lengths.size(); }
+
+    /** Returns the number of elements in a block. */
+    uint32_t block_length(uint32_t block) const {
+        return block < block_lengths.size() ? block_lengths[block] : 0;
+    }
+
+    /**
+     * Places the elements of a block at an offset within the row, for the
+     * RowLayout::CACHE_LINE_BLOCKS layout; offsets are relative to the start
+     * of the row until set_block_base is called. Returns the space they use.
+     */
+    int place_block(uint32_t block, int offset) {
+        if(block >= block_lengths.size() || block_lengths[block] == 0) {
+            return 0;
+        }
+        for(uint32_t i = 0; i < block_lengths[block]; ++i) {
+            element_offsets[block_starts[block] + i] = offset + i * sizeof(T);
+        }
+        return padded_len(block_lengths[block] * sizeof(T));
+    }
+
+    /** Sets the base for a field whose blocks were placed with place_block. */
+    void set_block_base(volatile char* const row_start) {
+        this->base = row_start;
+    }
+};
+
 typedef std::function<void(uint32_t)> failure_upcall_t;
 
+/**
+ * Tracks the remote writes posted by one call to
+ * SST::put_with_completion_async. It is resolved, by the thread that
+ * delivers completions, once every write has completed or the completion
+ * timeout has passed.
+ */
+class completion_ticket {
+    mutable std::mutex done_mutex;
+    mutable std::condition_variable done_cv;
+    std::atomic<bool> done{false};
+    /** The rows written to, and the completion key of each one's transport. */
+    std::vector<std::pair<uint32_t, uint32_t>> rows_and_keys;
+    /** Whether the write to each row has completed. */
+    std::vector<bool> completed;
+    /** The number of writes still to complete. */
+    uint32_t remaining = 0;
+    /** The rows whose write failed or timed out. */
+    std::vector<uint32_t> failed;
+
+    /** Records a completion entry, (completion key, result). */
+    void complete(std::pair<int32_t, int32_t> ce) {
+        for(std::size_t i = 0; i < rows_and_keys.size(); ++i) {
+            if(rows_and_keys[i].second != (uint32_t)ce.first || completed[i]) {
+                continue;
+            }
+            completed[i] = true;
+            if(ce.second != 1) {
+                std::cerr << "Poll completion error in QP " << ce.first
+                          << ". Freezing row " << rows_and_keys[i].first << std::endl;
+                failed.push_back(rows_and_keys[i].first);
+            }
+            if(--remaining == 0) {
+                resolve();
+            }
+            return;
+        }
+    }
+
+    /** Reports every row whose write has not completed as failed. */
+    void expire() {
+        for(std::size_t i = 0; i < rows_and_keys.size(); ++i) {
+            if(!completed[i]) {
+                std::cout << "Reporting failure on row " << rows_and_keys[i].first
+                          << " due to a missing poll completion" << std::endl;
+                failed.push_back(rows_and_keys[i].first);
+            }
+        }
+        resolve();
+    }
+
+    void resolve() {
+        std::lock_guard<std::mutex> lock(done_mutex);
+        done = true;
+        done_cv.notify_all();
+    }
+
+    template <typename DerivedSST>
+    friend class SST;
+
+public:
+    /** Returns whether every write has completed or timed out. */
+    bool is_done() const { return done; }
+
+    /** Waits until every write has completed or timed out. */
+    void wait() const {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done_cv.wait(lock, [this]() { return done.load(); });
+    }
+
+    /** Returns the rows whose write failed or timed out; only meaningful
+     * once the ticket is done. */
+    const std::vector<uint32_t>& failed_rows() const { return failed; }
+};
+
+/** Enumeration defining how SST arranges the fields of a row. */
+enum class RowLayout {
+    /** Every field is contiguous, in the order the fields were declared. */
+    DECLARATION_ORDER,
+    /** The other fields come first, in declaration order; then, for each
+     * block index, the elements in that block of every SSTFieldBlockVector
+     * are stored together, starting on a new cache line. */
+    CACHE_LINE_BLOCKS
+};
+
+/**
+ * A private copy of one row of an SST, taken by SST::snapshot_row. Its fields
+ * are read by passing the SST's own field objects: snapshot[sst.field] for an
+ * SSTField, snapshot[sst.vector][i] for an SSTFieldVector, and
+ * snapshot(sst.block_vector, i) for an SSTFieldBlockVector.
+ */
+class row_snapshot {
+    std::vector<char> data;
+    /** The start of row 0 of the SST the copy was taken from. */
+    const volatile char* table_base = nullptr;
+
+    /** Returns where the copy holds the element at the given address in row 0. */
+    const char* locate(const volatile void* element_in_row_zero) const {
+        return data.data() + ((const volatile char*)element_in_row_zero - table_base);
+    }
+
+    template <typename DerivedSST>
+    friend class SST;
+
+public:
+    template <typename T>
+    const T& operator[](const SSTField<T>& field) const {
+        return *(const T*)locate(field.base);
+    }
+
+    template <typename T>
+    const T* operator[](const SSTFieldVector<T>& field) const {
+        return (const T*)locate(field.base);
+    }
+
+    template <typename T>
+    const T& operator()(const SSTFieldBlockVector<T>& field, const size_t idx) const {
+        return *(const T*)locate(&field[0][idx]);
+    }
+};
+
+/** Enumeration defining how the predicate evaluation thread waits when no
+ * predicate has fired for a while. */
+enum class WaitPolicy {
+    /** Keep evaluating predicates continuously; lowest latency, but uses a
+     * whole core even when idle. */
+    SPIN,
+    /** Spin for idle_spin_time_us, then yield the processor between passes. */
+    SPIN_THEN_YIELD,
+    /** Spin for idle_spin_time_us, then block until a local put or a
+     * predicate insertion, or for at most max_block_time_us. */
+    SPIN_THEN_BLOCK
+};
+
 /** Constructor parameter pack for SST. */
 struct SSTParams {
     const std::vector<uint32_t>& members;
@@ -124,6 +379,11 @@ struct SSTParams {
     const failure_upcall_t failure_upcall;
     const std::vector<char> already_failed;
     const bool start_predicate_thread;
+    const bool coalesce_puts;
+    const WaitPolicy wait_policy;
+    const uint32_t num_evaluation_threads;
+    const RowLayout row_layout;
+    const bool row_seqlock;
 
     /**
      *
@@ -140,17 +400,41 @@ struct SSTParams {
      * should be started immediately on construction of the SST. If false,
      * predicate evaluation will not start until start_predicate_evalution()
      * is called.
+     * @param coalesce_puts Whether puts issued by triggers should be deferred
+     * until the end of the predicate evaluation pass, so that puts to the
+     * same row can be merged into a single remote write.
+     * @param wait_policy How the predicate evaluation thread waits while
+     * no predicates are firing.
+     * @param num_evaluation_threads The number of threads evaluating
+     * predicates; predicate group g is evaluated by thread
+     * g % num_evaluation_threads.
+     * @param row_layout How the fields of each row are arranged.
+     * @param row_seqlock Whether each row carries sequence numbers around
+     * its fields, so that snapshot_row can copy a remote row without mixing
+     * the contents of two writes. The writes of each put, to all the rows it
+     * targets, then wait for those of the previous put to complete, which
+     * costs a round trip per put.
      */
     SSTParams(const std::vector<uint32_t>& _members,
               const uint32_t my_node_id,
               const failure_upcall_t failure_upcall = nullptr,
               const std::vector<char> already_failed = {},
-              const bool start_predicate_thread = true)
+              const bool start_predicate_thread = true,
+              const bool coalesce_puts = false,
+              const WaitPolicy wait_policy = WaitPolicy::SPIN_THEN_BLOCK,
+              const uint32_t num_evaluation_threads = 1,
+              const RowLayout row_layout = RowLayout::DECLARATION_ORDER,
+              const bool row_seqlock = false)
             : members(_members),
               my_node_id(my_node_id),
               failure_upcall(failure_upcall),
               already_failed(already_failed),
-              start_predicate_thread(start_predicate_thread) {}
+              start_predicate_thread(start_predicate_thread),
+              coalesce_puts(coalesce_puts),
+              wait_policy(wait_policy),
+              num_evaluation_threads(num_evaluation_threads),
+              row_layout(row_layout),
+              row_seqlock(row_seqlock) {}
 };
 
 template <class DerivedSST>
@@ -158,11 +442,25 @@ class SST {
 private:
     template <typename... Fields>
     void init_SSTFields(Fields&... fields) {
-        rowLen = 0;
+        // the begin sequence number comes before the fields, and the end one after them
+        const int sequence_len = row_seqlock ? sizeof(uint64_t) : 0;
+        rowLen = sequence_len;
         compute_rowLen(rowLen, fields...);
-        rows = new char[rowLen * num_members];
+        if(row_layout == RowLayout::CACHE_LINE_BLOCKS) {
+            // each block starts on a new cache line, and so does each row
+            const uint32_t num_blocks = count_blocks(fields...);
+            for(uint32_t block = 0; block < num_blocks; ++block) {
+                rowLen = cache_line_padded_len(rowLen);
+                place_block(block, rowLen, fields...);
+            }
+        }
+        rowLen += sequence_len;
+        if(row_layout == RowLayout::CACHE_LINE_BLOCKS) {
+            rowLen = cache_line_padded_len(rowLen);
+        }
+        rows = allocate_rows(rowLen * num_members);
         // snapshot = new char[rowLen * num_members];
-        volatile char* base = rows;
+        volatile char* base = rows + sequence_len;
         set_bases_and_rowLens(base, rowLen, fields...);
     }
 
@@ -171,7 +469,38 @@ private:
     std::vector<std::thread> background_threads;
     std::atomic<bool> thread_shutdown;
 
-    void detect();
+    /** The state that each predicate evaluation thread keeps for itself. */
+    struct evaluator_state {
+        /** The SST this thread evaluates predicates for. */
+        SST* owner;
+        /** The predicate groups evaluated by this thread. */
+        std::vector<typename Predicates<DerivedSST>::predicate_group*> groups;
+        /** Value of predicates.groups_version when groups was last updated. */
+        uint64_t groups_version;
+        /** For each row, the byte ranges [begin, end) of the local row that
+         * were put to it during the current pass and not yet written. */
+        std::vector<std::vector<std::pair<long long int, long long int>>> deferred_puts;
+    };
+
+    /** The evaluation thread state of the calling thread, if it is an
+     * evaluation thread of some SST<DerivedSST>. */
+    static evaluator_state*& evaluator_on_this_thread() {
+        static thread_local evaluator_state* evaluator = nullptr;
+        return evaluator;
+    }
+
+    /** Returns the calling thread's state if it is one of this SST's
+     * evaluation threads, or nullptr otherwise. */
+    evaluator_state* current_evaluator() {
+        evaluator_state* evaluator = evaluator_on_this_thread();
+        return (evaluator && evaluator->owner == this) ? evaluator : nullptr;
+    }
+
+    void detect(uint32_t thread_index);
+
+    /** Evaluates the predicates of one group, running triggers as needed;
+     * returns whether any predicate fired. */
+    bool evaluate_group(typename Predicates<DerivedSST>::predicate_group& group);
 
 public:
     Predicates<DerivedSST> predicates;
@@ -183,6 +512,8 @@ private:
     // char* snapshot;
     /** Length of each row in this SST, in bytes. */
     int rowLen;
+    /** How the fields are arranged in each row. */
+    const RowLayout row_layout;
     /** List of nodes in the SST; indexes are row numbers, values are node IDs. */
     const std::vector<uint32_t>& members;
     /** Equal to members.size() */
@@ -207,8 +538,38 @@ private:
     /** Mutex for failure detection and row freezing. */
     std::mutex freeze_mutex;
 
-    /** RDMA resources vector, one for each member. */
-    std::vector<std::unique_ptr<resources>> res_vec;
+    /** Row transports (RDMA or shared memory), one for each member. */
+    std::vector<std::unique_ptr<row_transport>> res_vec;
+
+    /** Whether each row is framed by a begin and an end sequence number. */
+    const bool row_seqlock;
+    /** Serializes the remote writes of rows framed by sequence numbers. */
+    std::mutex seqlock_mutex;
+    /** The sequence number of the latest write of the local row. */
+    uint64_t write_sequence{0};
+    /** Track the writes of the end sequence number in the latest frame,
+     * which must complete before the sequence numbers change. */
+    std::vector<std::shared_ptr<completion_ticket>> framed_writes_in_flight;
+
+    /** Returns the begin sequence number of a row; the end one is the last
+     * word of the row. */
+    volatile uint64_t& begin_sequence(uint32_t row) const {
+        return *(volatile uint64_t*)(rows + row * rowLen);
+    }
+    volatile uint64_t& end_sequence(uint32_t row) const {
+        return *(volatile uint64_t*)(rows + (row + 1) * rowLen - sizeof(uint64_t));
+    }
+
+    /** Writes part of the local row to the owner of another row, framing it
+     * with both sequence numbers if rows carry them. The writes posted with
+     * the same frame lock, which the first of them takes, share a frame. */
+    void post_write(std::unique_lock<std::mutex>& frame, uint32_t index, long long int offset,
+                    long long int size, bool with_completion = false, uint32_t completion_id = 0);
+
+    /** Tickets of asynchronous puts whose failed rows have not been frozen yet. */
+    std::list<std::shared_ptr<completion_ticket>> outstanding_tickets;
+    /** Protects outstanding_tickets. */
+    std::mutex tickets_mutex;
 
     /** Indicates whether the predicate evaluation thread should start after being
      * forked in the constructor. */
@@ -218,10 +579,50 @@ private:
     /** Notified when the predicate evaluation thread should start. */
     std::condition_variable thread_start_cv;
 
+    /** Whether puts made by the predicate evaluation threads are deferred
+     * to the end of each evaluation pass and merged. */
+    const bool coalesce_puts;
+    /** Number of remote writes that merging deferred puts has avoided. */
+    std::atomic<uint64_t> num_writes_saved{0};
+
+    /** Writes out an evaluation thread's deferred puts, one write per group
+     * of nearby ranges in each row. */
+    void flush_deferred_puts(evaluator_state& evaluator);
+
+    /** Records which of a group's declared input ranges have changed. */
+    void check_watched_inputs(typename Predicates<DerivedSST>::predicate_group& group);
+
+    /** Number of threads evaluating predicates. */
+    const uint32_t num_evaluation_threads;
+    /** How the predicate evaluation threads wait while idle. */
+    const WaitPolicy wait_policy;
+    /** Mutex for wait_cv, wake_generation and wake_request_time. */
+    std::mutex wait_mutex;
+    /** Notified to wake the evaluation threads that are blocked. */
+    std::condition_variable wait_cv;
+    /** Incremented every time the blocked evaluation threads are woken. */
+    uint64_t wake_generation{0};
+    /** Number of evaluation threads blocked on wait_cv. */
+    std::atomic<uint32_t> num_blocked_threads{0};
+    /** When the latest wake-up was requested, in nanoseconds. */
+    uint64_t wake_request_time{0};
+    /** Time from a wake-up request to the evaluation thread running again. */
+    duration_histogram wake_latency;
+    /** For each idle period, the time the evaluation thread spent running
+     * (spinning or yielding) rather than blocked before a predicate fired again. */
+    duration_histogram idle_cpu_time;
+
+    /** Lets an evaluation thread wait according to wait_policy; returns how
+     * long it was blocked, in nanoseconds. */
+    uint64_t wait_while_idle(uint64_t idle_ns);
+    /** Wakes the predicate evaluation threads that are blocked. */
+    void wake_detect_thread();
+
 public:
     SST(DerivedSST* derived_class_pointer, const SSTParams& params)
             : derived_this(derived_class_pointer),
               thread_shutdown(false),
+              row_layout(params.row_layout),
               members(params.members),
               num_members(members.size()),
               all_indices(num_members),
@@ -229,7 +630,12 @@ public:
               row_is_frozen(num_members),
               failure_upcall(params.failure_upcall),
               res_vec(num_members),
-              thread_start(params.start_predicate_thread) {
+              row_seqlock(params.row_seqlock),
+              thread_start(params.start_predicate_thread),
+              coalesce_puts(params.coalesce_puts),
+              num_evaluation_threads(std::max(params.num_evaluation_threads, 1u)),
+              wait_policy(params.wait_policy) {
+        predicates.insert_callback = [this]() { wake_detect_thread(); };
         //Figure out my SST index
         for(uint32_t i = 0; i < num_members; ++i) {
             if(members[i] == my_node_id) {
@@ -271,15 +677,17 @@ public:
                 if(row_is_frozen[sst_index]) {
                     continue;
                 }
-                res_vec[sst_index] = std::make_unique<resources>(
+                res_vec[sst_index] = make_row_transport(
                         node_rank, write_addr, read_addr, rowLen, rowLen);
                 // update qp_num_to_index
-                qp_num_to_index[res_vec[sst_index].get()->qp->qp_num] = sst_index;
+                qp_num_to_index[res_vec[sst_index]->get_completion_key()] = sst_index;
             }
         }
 
-        std::thread detector(&SST::detect, this);
-        background_threads.push_back(std::move(detector));
+        for(uint32_t thread_index = 0; thread_index < num_evaluation_threads; ++thread_index) {
+            std::thread detector(&SST::detect, this, thread_index);
+            background_threads.push_back(std::move(detector));
+        }
 
         std::cout << "Initialized SST and Started Threads" << std::endl;
     }
@@ -309,6 +717,33 @@ public:
         return const_cast<char*>(rows);
     }
 
+    /**
+     * Copies a row into snapshot. If the SST was constructed with
+     * row_seqlock, the copy of a remote row holds the contents of a single
+     * write of that row, retrying while a write is landing; otherwise it may
+     * mix the contents of several writes. Updates of the local row are not
+     * framed by sequence numbers, so a copy of the local row is taken as is.
+     */
+    void snapshot_row(uint32_t row, row_snapshot& snapshot) const;
+
+    row_snapshot snapshot_row(uint32_t row) const {
+        row_snapshot snapshot;
+        snapshot_row(row, snapshot);
+        return snapshot;
+    }
+
+    /** Returns the number of remote writes saved so far by merging puts
+     * made during the same predicate evaluation pass. */
+    uint64_t get_num_writes_saved() const { return num_writes_saved; }
+
+    /** Returns the histogram of the time the predicate evaluation threads
+     * took to resume after being woken by a put or predicate insertion. */
+    const duration_histogram& get_wake_latency_histogram() const { return wake_latency; }
+
+    /** Returns the histogram of CPU time the predicate evaluation threads
+     * spent without blocking in each period in which no predicate fired. */
+    const duration_histogram& get_idle_cpu_histogram() const { return idle_cpu_time; }
+
     /** Writes the entire local row to all remote nodes. */
     void put() {
         put(all_indices, 0, rowLen);
@@ -339,8 +774,26 @@ public:
     /** Writes a contiguous subset of the local row to some of the remote nodes. */
     void put(const std::vector<uint32_t> receiver_ranks, long long int offset, long long int size);
 
+    /** Writes a contiguous subset of the local row to some of the remote
+     * nodes, and waits until the writes complete, freezing the rows of
+     * nodes whose write failed or timed out. */
     void put_with_completion(const std::vector<uint32_t> receiver_ranks, long long int offset, long long int size);
 
+    std::shared_ptr<completion_ticket> put_with_completion_async(long long int offset, long long int size) {
+        return put_with_completion_async(all_indices, offset, size);
+    }
+
+    /** Writes a contiguous subset of the local row to some of the remote
+     * nodes without waiting for the writes to complete; the returned ticket
+     * is resolved once they have. Rows whose write failed are frozen by a
+     * later call to this, put_with_completion or process_completed_puts. */
+    std::shared_ptr<completion_ticket> put_with_completion_async(const std::vector<uint32_t> receiver_ranks,
+                                                                 long long int offset, long long int size);
+
+    /** Freezes the rows whose write failed in asynchronous puts that have
+     * completed since the last call. */
+    void process_completed_puts();
+
 private:
     using char_p = volatile char*;
 
@@ -352,6 +805,40 @@ private:
         compute_rowLen(rowLen, rest...);
     }
 
+    // Block vectors take no space here if their blocks are placed separately
+    template <typename T, typename... Fields>
+    void compute_rowLen(int& rowLen, SSTFieldBlockVector<T>& f, Fields&... rest) {
+        if(row_layout == RowLayout::DECLARATION_ORDER) {
+            rowLen += padded_len(f.field_len);
+        }
+        compute_rowLen(rowLen, rest...);
+    }
+
+    uint32_t count_blocks() { return 0; }
+
+    template <typename Field, typename... Fields>
+    uint32_t count_blocks(Field& f, Fields&... rest) {
+        return count_blocks(rest...);
+    }
+
+    template <typename T, typename... Fields>
+    uint32_t count_blocks(SSTFieldBlockVector<T>& f, Fields&... rest) {
+        return std::max(f.num_blocks(), count_blocks(rest...));
+    }
+
+    void place_block(const uint32_t, int&) {}
+
+    template <typename Field, typename... Fields>
+    void place_block(const uint32_t block, int& rowLen, Field& f, Fields&... rest) {
+        place_block(block, rowLen, rest...);
+    }
+
+    template <typename T, typename... Fields>
+    void place_block(const uint32_t block, int& rowLen, SSTFieldBlockVector<T>& f, Fields&... rest) {
+        rowLen += f.place_block(block, rowLen);
+        place_block(block, rowLen, rest...);
+    }
+
     void set_bases_and_rowLens(char_p&, const int) {}
 
     template <typename Field, typename... Fields>
@@ -361,6 +848,18 @@ private:
         set_bases_and_rowLens(base, rlen, rest...);
     }
 
+    template <typename T, typename... Fields>
+    void set_bases_and_rowLens(char_p& base, const int rlen, SSTFieldBlockVector<T>& f, Fields&... rest) {
+        if(row_layout == RowLayout::DECLARATION_ORDER) {
+            base += f.set_base(base);
+        } else {
+            // element offsets are relative to the start of the row
+            f.set_block_base(rows);
+        }
+        f.set_rowLen(rlen);
+        set_bases_and_rowLens(base, rlen, rest...);
+    }
+
     // void take_snapshot() {
     //   memcpy(snapshot, const_cast<char*>(rows), rowLen * num_members);
     // }
@@ -6,11 +6,13 @@
 
 #pragma once
 
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <pthread.h>
+#include <string>
 #include <sys/time.h>
 #include <thread>
 #include <time.h>
@@ -22,6 +24,13 @@
 
 namespace sst {
 
+/** Returns the current time from the monotonic clock, in nanoseconds. */
+inline uint64_t monotonic_time_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
 /**
  * Destructor for the SST object; sets thread_shutdown to true and waits for
  * background threads to exit cleanly.
@@ -29,12 +38,13 @@ namespace sst {
 template <typename DerivedSST>
 SST<DerivedSST>::~SST() {
     thread_shutdown = true;
+    wake_detect_thread();
     for(auto& thread : background_threads) {
         if(thread.joinable()) thread.join();
     }
 
     if(rows != nullptr) {
-        delete[](const_cast<char*>(rows));
+        free_rows(const_cast<char*>(rows));
     }
 }
 
@@ -51,199 +61,478 @@ void SST<DerivedSST>::start_predicate_evaluation() {
 }
 
 /**
- * This function is run in a detached background thread to detect predicate
- * events. It continuously evaluates predicates one by one, and runs the
- * trigger functions for each predicate that fires. In addition, it
- * continuously evaluates named functions one by one, and updates the local
- * row's observed values of those functions.
+ * Called when the local row may have changed or a predicate was inserted.
+ * This is cheap unless an evaluation thread is actually blocked, so it is
+ * safe to call on every put.
+ */
+template <typename DerivedSST>
+void SST<DerivedSST>::wake_detect_thread() {
+    if(num_blocked_threads == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(wait_mutex);
+    wake_generation++;
+    wake_request_time = monotonic_time_ns();
+    wait_cv.notify_all();
+}
+
+/**
+ * @param idle_ns How long it has been since a predicate last fired on the
+ * calling evaluation thread.
+ */
+template <typename DerivedSST>
+uint64_t SST<DerivedSST>::wait_while_idle(uint64_t idle_ns) {
+    if(wait_policy == WaitPolicy::SPIN || idle_ns < idle_spin_time_us * 1000ull) {
+        return 0;
+    }
+    if(wait_policy == WaitPolicy::SPIN_THEN_YIELD) {
+        std::this_thread::yield();
+        return 0;
+    }
+    uint64_t block_start = monotonic_time_ns();
+    std::unique_lock<std::mutex> lock(wait_mutex);
+    const uint64_t generation = wake_generation;
+    num_blocked_threads++;
+    wait_cv.wait_for(lock, std::chrono::microseconds(max_block_time_us),
+                     [this, generation]() { return wake_generation != generation || thread_shutdown; });
+    num_blocked_threads--;
+    uint64_t block_end = monotonic_time_ns();
+    if(wake_generation != generation) {
+        wake_latency.record(block_end - wake_request_time);
+    }
+    return block_end - block_start;
+}
+
+/**
+ * This function is run in a background thread to detect predicate events.
+ * Each of the num_evaluation_threads threads continuously evaluates the
+ * predicates of its own predicate groups one by one, and runs the trigger
+ * functions for each predicate that fires.
+ * @param thread_index The index of this evaluation thread.
  */
 template <typename DerivedSST>
-void SST<DerivedSST>::detect() {
-    pthread_setname_np(pthread_self(), "sst_detect");
+void SST<DerivedSST>::detect(uint32_t thread_index) {
+    std::string thread_name = "sst_detect";
+    if(thread_index > 0) {
+        thread_name += "_" + std::to_string(thread_index);
+    }
+    pthread_setname_np(pthread_self(), thread_name.c_str());
     if(!thread_start) {
         std::unique_lock<std::mutex> lock(thread_start_mutex);
         thread_start_cv.wait(lock, [this]() { return thread_start; });
     }
-    struct timespec last_time, cur_time;
-    clock_gettime(CLOCK_REALTIME, &last_time);
+    evaluator_state evaluator{this, {}, 0, std::vector<std::vector<std::pair<long long int, long long int>>>(num_members)};
+    evaluator_on_this_thread() = &evaluator;
+    // time at which a predicate last fired
+    uint64_t last_time = monotonic_time_ns();
+    // time spent blocked since then
+    uint64_t blocked_time = 0;
+    // whether any pass since then fired nothing
+    bool was_idle = false;
 
     while(!thread_shutdown) {
         try {
-            bool predicate_fired = false;
-            // Take the predicate lock before reading the predicate lists
-            std::unique_lock<std::mutex> predicates_lock(predicates.predicate_mutex);
-
-            // one time predicates need to be evaluated only until they become true
-            for(auto& pred : predicates.one_time_predicates) {
-                if(pred != nullptr && (pred->first(*derived_this) == true)) {
-                    predicate_fired = true;
-                    // Copy the trigger pointer locally, so it can continue running without
-                    // segfaulting even if this predicate gets deleted when we unlock predicates_lock
-                    std::shared_ptr<typename Predicates<DerivedSST>::trig> trigger(pred->second);
-                    predicates_lock.unlock();
-                    (*trigger)(*derived_this);
-                    predicates_lock.lock();
-                    // erase the predicate as it was just found to be true
-                    pred.reset();
-                }
+            // pick up any groups created since the last pass
+            uint64_t groups_version = predicates.groups_version;
+            if(groups_version != evaluator.groups_version) {
+                predicates.get_groups_for_thread(thread_index, num_evaluation_threads, evaluator.groups);
+                evaluator.groups_version = groups_version;
             }
 
-            // recurrent predicates are evaluated each time they are found to be true
-            for(auto& pred : predicates.recurrent_predicates) {
-                if(pred != nullptr && (pred->first(*derived_this) == true)) {
-                    predicate_fired = true;
-                    std::shared_ptr<typename Predicates<DerivedSST>::trig> trigger(pred->second);
-                    predicates_lock.unlock();
-                    (*trigger)(*derived_this);
-                    predicates_lock.lock();
-                }
+            bool predicate_fired = false;
+            for(auto group : evaluator.groups) {
+                predicate_fired |= evaluate_group(*group);
             }
 
-            // transition predicates are only evaluated when they change from false to true
-            // We need to use iterators here because we need to iterate over two lists in parallel
-            auto pred_it = predicates.transition_predicates.begin();
-            auto pred_state_it = predicates.transition_predicate_states.begin();
-            while(pred_it != predicates.transition_predicates.end()) {
-                if(*pred_it != nullptr) {
-                    //*pred_state_it is the previous state of the predicate at *pred_it
-                    bool curr_pred_state = (*pred_it)->first(*derived_this);
-                    if(curr_pred_state == true && *pred_state_it == false) {
-                        predicate_fired = true;
-                        std::shared_ptr<typename Predicates<DerivedSST>::trig> trigger(
-                                (*pred_it)->second);
-                        predicates_lock.unlock();
-                        (*trigger)(*derived_this);
-                        predicates_lock.lock();
-                    }
-                    *pred_state_it = curr_pred_state;
-
-                    ++pred_it;
-                    ++pred_state_it;
-                }
+            // write out everything the triggers put during this pass
+            if(coalesce_puts) {
+                flush_deferred_puts(evaluator);
             }
 
+            uint64_t cur_time = monotonic_time_ns();
             if(predicate_fired) {
-                // update last time
-                clock_gettime(CLOCK_REALTIME, &last_time);
-            } else {
-                clock_gettime(CLOCK_REALTIME, &cur_time);
-                // check if the system has been inactive for enough time to induce sleep
-                double time_elapsed_in_ms = (cur_time.tv_sec - last_time.tv_sec) * 1e3
-                                            + (cur_time.tv_nsec - last_time.tv_nsec) / 1e6;
-                if(time_elapsed_in_ms > 1) {
-                    predicates_lock.unlock();
-                    using namespace std::chrono_literals;
-                    std::this_thread::sleep_for(1ms);
-                    predicates_lock.lock();
+                if(was_idle) {
+                    idle_cpu_time.record(cur_time - last_time - blocked_time);
                 }
+                last_time = cur_time;
+                blocked_time = 0;
+                was_idle = false;
+            } else {
+                was_idle = true;
+                blocked_time += wait_while_idle(cur_time - last_time);
             }
-            //Still to do: Clean up deleted predicates
         } catch(const std::exception& e) {
             std::cout << "Exception in the SST detect thread: " << e.what() << std::endl;
             std::cout << "SST detect thread shutting down" << std::endl;
         }
     }
+    if(coalesce_puts) {
+        flush_deferred_puts(evaluator);
+    }
+    evaluator_on_this_thread() = nullptr;
 }
 
+/**
+ * Takes no lock: the group's predicate lists belong to this thread, and
+ * other threads only add pending insertions or mark predicates dead.
+ * Dead predicates are unlinked as they are reached, so removed predicates
+ * no longer cost anything on later passes.
+ */
 template <typename DerivedSST>
-void SST<DerivedSST>::put(const std::vector<uint32_t> receiver_ranks, long long int offset, long long int size) {
-    for(auto index : receiver_ranks) {
-        // don't write to yourself or a frozen row
-        if(index == my_index || row_is_frozen[index]) {
+bool SST<DerivedSST>::evaluate_group(typename Predicates<DerivedSST>::predicate_group& group) {
+    using predicate_entry = typename Predicates<DerivedSST>::predicate_entry;
+    bool predicate_fired = false;
+    // Evaluates a predicate unless it is dead, and runs its trigger if
+    // fires(result) says so, keeping trigger_epoch odd across both so that
+    // Predicates::remove can wait for them to finish. Returns whether the
+    // trigger ran.
+    auto evaluate = [this, &group](predicate_entry& entry, const auto& fires) {
+        group.trigger_epoch++;
+        if(group.is_dead(entry)) {
+            group.trigger_epoch++;
+            return false;
+        }
+        group.trigger_thread = std::this_thread::get_id();
+        bool fired;
+        try {
+            fired = fires(entry.predicate(*derived_this));
+            if(fired) {
+                entry.trigger(*derived_this);
+            }
+        } catch(...) {
+            group.trigger_thread = std::thread::id();
+            group.trigger_epoch++;
+            throw;
+        }
+        group.trigger_thread = std::thread::id();
+        group.trigger_epoch++;
+        return fired;
+    };
+
+    group.adopt_pending_inserts();
+
+    // find out which of the ranges that predicates declared as inputs have changed
+    check_watched_inputs(group);
+
+    // one time predicates need to be evaluated only until they become true
+    for(auto it = group.one_time_predicates.begin(); it != group.one_time_predicates.end();) {
+        predicate_entry& pred = **it;
+        if(group.is_dead(pred)) {
+            it = group.unlink(group.one_time_predicates, it);
             continue;
         }
-        // perform a remote RDMA write on the owner of the row
-        res_vec[index]->post_remote_write(0, offset, size);
+        if(!group.needs_evaluation(pred)) {
+            ++it;
+            continue;
+        }
+        pred.is_new = false;
+        if(evaluate(pred, [](bool result) { return result; })) {
+            predicate_fired = true;
+            // erase the predicate as it was just found to be true
+            it = group.unlink(group.one_time_predicates, it);
+        } else {
+            ++it;
+        }
     }
-    return;
-}
 
-template <typename DerivedSST>
-void SST<DerivedSST>::put_with_completion(const std::vector<uint32_t> receiver_ranks, long long int offset, long long int size) {
-    unsigned int num_writes_posted = 0;
-    std::vector<bool> posted_write_to(num_members, false);
+    // recurrent predicates are evaluated each time they are found to be true
+    for(auto it = group.recurrent_predicates.begin(); it != group.recurrent_predicates.end();) {
+        predicate_entry& pred = **it;
+        if(group.is_dead(pred)) {
+            it = group.unlink(group.recurrent_predicates, it);
+            continue;
+        }
+        ++it;
+        if(!group.needs_evaluation(pred)) {
+            continue;
+        }
+        pred.is_new = false;
+        if(evaluate(pred, [&pred](bool result) { return pred.last_result = result; })) {
+            predicate_fired = true;
+        }
+    }
 
-    const auto tid = std::this_thread::get_id();
-    // get id first
-    uint32_t id = util::polling_data.get_index(tid);
+    // transition predicates are only evaluated when they change from false to true
+    for(auto it = group.transition_predicates.begin(); it != group.transition_predicates.end();) {
+        predicate_entry& pred = **it;
+        if(group.is_dead(pred)) {
+            it = group.unlink(group.transition_predicates, it);
+            continue;
+        }
+        ++it;
+        if(!group.needs_evaluation(pred)) {
+            continue;
+        }
+        pred.is_new = false;
+        // last_result is the previous state of the predicate
+        auto fires = [&pred](bool curr_pred_state) {
+            bool prev_pred_state = pred.last_result;
+            pred.last_result = curr_pred_state;
+            return curr_pred_state == true && prev_pred_state == false;
+        };
+        if(evaluate(pred, fires)) {
+            predicate_fired = true;
+        }
+    }
+    return predicate_fired;
+}
 
-    util::polling_data.set_waiting(tid);
+/**
+ * Compares every range that a predicate in the group declared as an input
+ * against its contents at the previous check, in each watched row, and
+ * records whether it changed. This catches both remote writes and updates
+ * to the local row. Must only be called by the group's evaluation thread.
+ */
+template <typename DerivedSST>
+void SST<DerivedSST>::check_watched_inputs(typename Predicates<DerivedSST>::predicate_group& group) {
+    for(auto& watched : group.watched_inputs) {
+        if(watched.num_readers == 0) {
+            continue;
+        }
+        const auto& range = watched.range;
+        const std::size_t num_rows = range.rows.empty() ? num_members : range.rows.size();
+        if(watched.last_seen.size() != num_rows * range.size) {
+            watched.last_seen.assign(num_rows * range.size, 0);
+            watched.changed = true;
+        } else {
+            watched.changed = false;
+        }
+        for(std::size_t i = 0; i < num_rows; ++i) {
+            const auto row = range.rows.empty() ? i : range.rows[i];
+            const char* current = const_cast<char*>(rows) + row * rowLen + range.offset;
+            char* last_seen = watched.last_seen.data() + i * range.size;
+            if(memcmp(current, last_seen, range.size) != 0) {
+                memcpy(last_seen, current, range.size);
+                watched.changed = true;
+            }
+        }
+    }
+}
 
-    for(auto index : receiver_ranks) {
-        // don't write to yourself or a frozen row
-        if(index == my_index || row_is_frozen[index]) {
+/**
+ * Sorts the ranges recorded for each row and merges those that overlap or
+ * lie within put_coalesce_gap bytes of each other, so that each row normally
+ * receives a single write covering the minimal span of its dirty bytes.
+ * Must only be called by the evaluation thread that owns evaluator.
+ */
+template <typename DerivedSST>
+void SST<DerivedSST>::flush_deferred_puts(evaluator_state& evaluator) {
+    std::unique_lock<std::mutex> frame;
+    for(unsigned int index = 0; index < num_members; ++index) {
+        auto& ranges = evaluator.deferred_puts[index];
+        if(ranges.empty()) {
+            continue;
+        }
+        if(row_is_frozen[index]) {
+            ranges.clear();
             continue;
         }
-        // perform a remote RDMA write on the owner of the row
-        res_vec[index]->post_remote_write_with_completion(id, offset, size);
-        posted_write_to[index] = true;
-        num_writes_posted++;
+        std::sort(ranges.begin(), ranges.end());
+        uint64_t num_writes = 0;
+        long long int begin = ranges[0].first;
+        long long int end = ranges[0].second;
+        for(std::size_t i = 1; i < ranges.size(); ++i) {
+            if(ranges[i].first > end + put_coalesce_gap) {
+                post_write(frame, index, begin, end - begin);
+                num_writes++;
+                begin = ranges[i].first;
+            }
+            end = std::max(end, ranges[i].second);
+        }
+        post_write(frame, index, begin, end - begin);
+        num_writes++;
+        num_writes_saved += ranges.size() - num_writes;
+        ranges.clear();
     }
+}
 
-    // track which nodes haven't failed yet
-    std::vector<bool> polled_successfully_from(num_members, false);
+/**
+ * With row_seqlock, the data is written between a write of the begin
+ * sequence number and a write of the end one, both set to a new value
+ * first, so a reader that sees them equal before and after copying the row
+ * has not overlapped any write. This relies on the writes to a row landing
+ * in the order they were posted, which both transports provide. Over RDMA,
+ * the sequence numbers are read from the local row only when the writes
+ * execute, so the writes of one put, to every row, form a frame sharing
+ * the same numbers, and the next frame does not change them until every
+ * end write of this one has completed; writes to the same row complete in
+ * order, so the rest of the frame has landed by then too.
+ */
+template <typename DerivedSST>
+void SST<DerivedSST>::post_write(std::unique_lock<std::mutex>& frame, uint32_t index, long long int offset,
+                                 long long int size, bool with_completion, uint32_t completion_id) {
+    if(row_seqlock) {
+        if(!frame.owns_lock()) {
+            frame = std::unique_lock<std::mutex>(seqlock_mutex);
+            for(const auto& ticket : framed_writes_in_flight) {
+                ticket->wait();
+            }
+            framed_writes_in_flight.clear();
+            const uint64_t sequence = ++write_sequence;
+            begin_sequence(my_index) = sequence;
+            end_sequence(my_index) = sequence;
+        }
+        res_vec[index]->post_remote_write(0, 0, sizeof(uint64_t));
+    }
+    if(with_completion) {
+        res_vec[index]->post_remote_write_with_completion(completion_id, offset, size);
+    } else {
+        res_vec[index]->post_remote_write(0, offset, size);
+    }
+    if(row_seqlock) {
+        auto ticket = std::make_shared<completion_ticket>();
+        ticket->rows_and_keys.emplace_back(index, res_vec[index]->get_completion_key());
+        ticket->completed.assign(1, false);
+        ticket->remaining = 1;
+        uint32_t id;
+        // the write must be tracked, so wait for room among the pending completions
+        while((id = util::polling_data.register_operation(
+                       1, completion_timeout_ms,
+                       [ticket](std::pair<int32_t, int32_t> ce) { ticket->complete(ce); },
+                       [ticket]() { ticket->expire(); }))
+              == util::PollingData::invalid_index) {
+            std::this_thread::yield();
+        }
+        {
+            // a failed end write freezes the row, like any other tracked put
+            std::lock_guard<std::mutex> tickets_lock(tickets_mutex);
+            outstanding_tickets.push_back(ticket);
+        }
+        res_vec[index]->post_remote_write_with_completion(id, rowLen - sizeof(uint64_t), sizeof(uint64_t));
+        framed_writes_in_flight.push_back(std::move(ticket));
+    }
+}
 
-    std::vector<uint32_t> failed_node_indexes;
+/**
+ * The end sequence number is read before the row and the begin one after
+ * it, the reverse of the order they are written in. A row frozen in the
+ * middle of a write will never be completed, so it is copied as is.
+ */
+template <typename DerivedSST>
+void SST<DerivedSST>::snapshot_row(uint32_t row, row_snapshot& snapshot) const {
+    snapshot.data.resize(rowLen);
+    snapshot.table_base = rows;
+    const char* row_start = const_cast<const char*>(rows) + row * rowLen;
+    if(!row_seqlock || row == my_index) {
+        memcpy(snapshot.data.data(), row_start, rowLen);
+        return;
+    }
+    while(true) {
+        const uint64_t end = end_sequence(row);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        memcpy(snapshot.data.data(), row_start, rowLen);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(begin_sequence(row) == end || row_is_frozen[row]) {
+            return;
+        }
+    }
+}
 
-    /** Completion Queue poll timeout in millisec */
-    const int MAX_POLL_CQ_TIMEOUT = 2000;
-    unsigned long start_time_msec;
-    unsigned long cur_time_msec;
-    struct timeval cur_time;
-
-    // wait for completion for a while before giving up of doing it ..
-    gettimeofday(&cur_time, NULL);
-    start_time_msec = (cur_time.tv_sec * 1000) + (cur_time.tv_usec / 1000);
-
-    // poll for surviving number of rows
-    for(unsigned int index = 0; index < num_writes_posted; ++index) {
-        std::experimental::optional<std::pair<int32_t, int32_t>> ce;
-
-        while(true) {
-            // check if polling result is available
-            ce = util::polling_data.get_completion_entry(tid);
-            if(ce) {
-                break;
+template <typename DerivedSST>
+void SST<DerivedSST>::put(const std::vector<uint32_t> receiver_ranks, long long int offset, long long int size) {
+    // triggers' puts are merged and written at the end of the evaluation pass
+    evaluator_state* evaluator = coalesce_puts ? current_evaluator() : nullptr;
+    const bool defer = evaluator != nullptr;
+    {
+        std::unique_lock<std::mutex> frame;
+        for(auto index : receiver_ranks) {
+            // don't write to yourself or a frozen row
+            if(index == my_index || row_is_frozen[index]) {
+                continue;
             }
-            gettimeofday(&cur_time, NULL);
-            cur_time_msec = (cur_time.tv_sec * 1000) + (cur_time.tv_usec / 1000);
-            if((cur_time_msec - start_time_msec) >= MAX_POLL_CQ_TIMEOUT) {
-                break;
+            if(defer) {
+                evaluator->deferred_puts[index].emplace_back(offset, offset + size);
+                continue;
             }
+            // perform a remote write on the owner of the row
+            post_write(frame, index, offset, size);
         }
-        // if waiting for a completion entry timed out
-        if(!ce) {
-            // find some node that hasn't been polled yet and report it
-            for(unsigned int index2 = 0; index2 < num_members; ++index2) {
-                if(!posted_write_to[index2] || polled_successfully_from[index2]) {
-                    continue;
-                }
+    }
+    // a local update may have made some predicate true
+    if(!defer) {
+        wake_detect_thread();
+    }
+    return;
+}
 
-                std::cout << "Reporting failure on row " << index2
-                          << " due to a missing poll completion" << std::endl;
-                failed_node_indexes.push_back(index2);
-            }
-            continue;
+template <typename DerivedSST>
+void SST<DerivedSST>::put_with_completion(const std::vector<uint32_t> receiver_ranks, long long int offset, long long int size) {
+    auto ticket = put_with_completion_async(receiver_ranks, offset, size);
+    ticket->wait();
+    process_completed_puts();
+}
+
+/**
+ * The completions are delivered straight to the ticket by the thread
+ * polling for them, which also resolves the ticket if they have not all
+ * arrived within completion_timeout_ms, so no thread needs to wait for them.
+ */
+template <typename DerivedSST>
+std::shared_ptr<completion_ticket> SST<DerivedSST>::put_with_completion_async(
+        const std::vector<uint32_t> receiver_ranks, long long int offset, long long int size) {
+    // keep this write ordered after any puts a trigger has already made
+    if(coalesce_puts) {
+        if(evaluator_state* evaluator = current_evaluator()) {
+            flush_deferred_puts(*evaluator);
         }
+    }
+    process_completed_puts();
 
-        auto ce_v = ce.value();
-        int qp_num = ce_v.first;
-        int result = ce_v.second;
-        if(result == 1) {
-            int index = qp_num_to_index[qp_num];
-            polled_successfully_from[index] = true;
-        } else if(result == -1) {
-            int index = qp_num_to_index[qp_num];
-            if(!row_is_frozen[index]) {
-                std::cerr << "Poll completion error in QP " << qp_num
-                          << ". Freezing row " << index << std::endl;
-                failed_node_indexes.push_back(index);
-            }
+    auto ticket = std::make_shared<completion_ticket>();
+    for(auto index : receiver_ranks) {
+        // don't write to yourself or a frozen row
+        if(index == my_index || row_is_frozen[index]) {
+            continue;
         }
+        ticket->rows_and_keys.emplace_back(index, res_vec[index]->get_completion_key());
+    }
+    ticket->completed.assign(ticket->rows_and_keys.size(), false);
+    ticket->remaining = ticket->rows_and_keys.size();
+    if(ticket->remaining == 0) {
+        ticket->resolve();
+        return ticket;
     }
 
-    util::polling_data.reset_waiting(tid);
+    {
+        std::lock_guard<std::mutex> lock(tickets_mutex);
+        outstanding_tickets.push_back(ticket);
+    }
+    uint32_t id = util::polling_data.register_operation(
+            ticket->remaining, completion_timeout_ms,
+            [ticket](std::pair<int32_t, int32_t> ce) { ticket->complete(ce); },
+            [ticket]() { ticket->expire(); });
+    std::unique_lock<std::mutex> frame;
+    if(id == util::PollingData::invalid_index) {
+        // too many writes in flight to track this one; send it untracked
+        std::cout << "Too many pending completions; posting writes without completion" << std::endl;
+        for(const auto& row_and_key : ticket->rows_and_keys) {
+            post_write(frame, row_and_key.first, offset, size);
+        }
+        ticket->resolve();
+        return ticket;
+    }
+    for(const auto& row_and_key : ticket->rows_and_keys) {
+        // perform a remote write on the owner of the row
+        post_write(frame, row_and_key.first, offset, size, true, id);
+    }
+    return ticket;
+}
 
+template <typename DerivedSST>
+void SST<DerivedSST>::process_completed_puts() {
+    std::vector<uint32_t> failed_node_indexes;
+    {
+        std::lock_guard<std::mutex> lock(tickets_mutex);
+        for(auto it = outstanding_tickets.begin(); it != outstanding_tickets.end();) {
+            if(!(*it)->is_done()) {
+                ++it;
+                continue;
+            }
+            const auto& failed = (*it)->failed_rows();
+            failed_node_indexes.insert(failed_node_indexes.end(), failed.begin(), failed.end());
+            it = outstanding_tickets.erase(it);
+        }
+    }
     for(auto index : failed_node_indexes) {
         freeze(index);
     }
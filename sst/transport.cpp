@@ -0,0 +1,53 @@
+/**
+ * @file transport.cpp
+ * Dispatches SST row transport requests to the selected backend.
+ */
+#include <cstdlib>
+#include <cstring>
+
+#include "shm.h"
+#include "transport.h"
+#include "verbs.h"
+
+namespace sst {
+
+/** The backend used by new SST instances; RDMA unless shm_initialize was called. */
+static TransportType transport_type = TransportType::RDMA;
+
+void set_transport_type(TransportType type) {
+    transport_type = type;
+}
+
+TransportType get_transport_type() {
+    return transport_type;
+}
+
+std::unique_ptr<row_transport> make_row_transport(int r_index, char* write_addr, char* read_addr,
+                                                  int size_w, int size_r) {
+    if(transport_type == TransportType::SHARED_MEMORY) {
+        return std::make_unique<shm_resources>(r_index, write_addr, read_addr, size_w, size_r);
+    }
+    return std::make_unique<resources>(r_index, write_addr, read_addr, size_w, size_r);
+}
+
+char* allocate_rows(std::size_t size) {
+    if(transport_type == TransportType::SHARED_MEMORY) {
+        return shm_allocate_rows(size);
+    }
+    void* rows = nullptr;
+    if(posix_memalign(&rows, cache_line_size, size) != 0) {
+        return nullptr;
+    }
+    memset(rows, 0, size);
+    return (char*)rows;
+}
+
+void free_rows(char* rows) {
+    if(transport_type == TransportType::SHARED_MEMORY) {
+        shm_free_rows(rows);
+        return;
+    }
+    free(rows);
+}
+
+}  // namespace sst
@@ -0,0 +1,63 @@
+#pragma once
+
+/**
+ * @file transport.h
+ * Contains the interface between SST and the mechanism that moves bytes of
+ * the local row into remote copies of it, so that the same SST can run over
+ * RDMA or over shared memory.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace sst {
+
+/** The size of a cache line; tables are allocated on cache-line boundaries. */
+const int cache_line_size = 64;
+
+/** Enumeration defining the row transports an SST can use. */
+enum class TransportType {
+    /** One-sided RDMA writes through IB Verbs (see verbs.h). */
+    RDMA,
+    /** Direct stores into the tables of other processes on the same host
+     * (see shm.h). */
+    SHARED_MEMORY
+};
+
+/**
+ * Represents the means of writing the local row into the copy of it held by
+ * a single remote node. SST keeps one row_transport for each remote row.
+ */
+class row_transport {
+public:
+    virtual ~row_transport() {}
+    /** Returns the identifier carried by the completion entries that this
+     * transport reports (the queue pair number, for RDMA). */
+    virtual uint32_t get_completion_key() const = 0;
+    /** Post a write at an offset into remote memory. */
+    virtual void post_remote_write(const uint32_t id, const long long int offset, const long long int size) = 0;
+    /** Post a write at an offset into remote memory, and report a completion
+     * entry for id to util::polling_data once it has finished. */
+    virtual void post_remote_write_with_completion(const uint32_t id, const long long int offset, const long long int size) = 0;
+};
+
+/** Selects the transport used by SST instances created from now on. */
+void set_transport_type(TransportType type);
+/** Returns the transport selected by verbs_initialize or shm_initialize. */
+TransportType get_transport_type();
+
+/**
+ * Creates a transport of the selected type connecting this node to a single
+ * remote node. The parameters are the same as those of resources' constructor.
+ */
+std::unique_ptr<row_transport> make_row_transport(int r_index, char* write_addr, char* read_addr,
+                                                  int size_w, int size_r);
+
+/** Allocates zeroed, cache-line-aligned memory for an SST table, in a form
+ * that the selected transport can deliver remote writes into. */
+char* allocate_rows(std::size_t size);
+/** Frees memory previously returned by allocate_rows. */
+void free_rows(char* rows);
+
+}  // namespace sst
@@ -2,6 +2,7 @@
  * @file verbs.cpp
  * Contains the implementation of the IB Verbs adapter layer of %SST.
  */
+#include <algorithm>
 #include <arpa/inet.h>
 #include <byteswap.h>
 #include <cstring>
@@ -404,12 +405,20 @@ void resources::post_remote_write_with_completion(const uint32_t id, const long
     }
 }
 
+uint32_t resources::get_completion_key() const {
+    return qp->qp_num;
+}
+
 void polling_loop() {
     pthread_setname_np(pthread_self(), "sst_poll");
     cout << "Polling thread starting" << endl;
+    std::pair<uint32_t, std::pair<int, int>> entries[completion_batch_size];
     while(!shutdown) {
-        auto ce = verbs_poll_completion();
-        util::polling_data.insert_completion_entry(ce.first, ce.second);
+        int num_entries = verbs_poll_completions(entries, completion_batch_size);
+        for(int i = 0; i < num_entries; ++i) {
+            util::polling_data.insert_completion_entry(entries[i].first, entries[i].second);
+        }
+        util::polling_data.expire_operations();
     }
     cout << "Polling thread ending" << endl;
 }
@@ -418,27 +427,38 @@ void polling_loop() {
  * @details
  * This blocks until a single entry in the completion queue has
  * completed
- * It is exclusively used by the polling thread
- * the thread can sleep while in this function, when it calls util::polling_data.wait_for_requests
  * @return pair(qp_num,result) The queue pair number associated with the
  * completed request and the result (1 for successful, -1 for unsuccessful)
  */
 std::pair<uint32_t, std::pair<int, int>> verbs_poll_completion() {
-    struct ibv_wc wc;
-    int poll_result;
+    std::pair<uint32_t, std::pair<int, int>> entry{0, {0, -1}};
+    while(!shutdown && verbs_poll_completions(&entry, 1) == 0) {
+        // util::polling_data.wait_for_requests();
+    }
+    return entry;
+}
 
-    while(!shutdown) {
-        poll_result = 0;
-        for(int i = 0; i < 50; ++i) {
-            poll_result = ibv_poll_cq(g_res->cq, 1, &wc);
-            if(poll_result) {
-                break;
-            }
-        }
+/**
+ * @details
+ * This polls the completion queue a bounded number of times, until it
+ * finds completed entries, and takes up to max_entries of them with a
+ * single poll. It is used by the polling thread, which returns to it after
+ * expiring any asynchronous operations that have timed out.
+ * @param entries Filled with pair(wr_id, pair(qp_num, result)) for each
+ * completed request, where result is 1 for successful and -1 for unsuccessful
+ * @param max_entries The size of entries
+ * @return The number of entries filled in, which is 0 if none completed
+ */
+int verbs_poll_completions(std::pair<uint32_t, std::pair<int, int>>* entries, int max_entries) {
+    struct ibv_wc wcs[completion_batch_size];
+    int poll_result = 0;
+    max_entries = std::min(max_entries, completion_batch_size);
+
+    for(int i = 0; i < 50; ++i) {
+        poll_result = ibv_poll_cq(g_res->cq, max_entries, wcs);
         if(poll_result) {
             break;
         }
-        // util::polling_data.wait_for_requests();
     }
     // not sure what to do when we cannot read entries off the CQ
     // this means that something is wrong with the local node
@@ -446,14 +466,19 @@ std::pair<uint32_t, std::pair<int, int>> verbs_poll_completion() {
         cout << "Poll completion failed" << endl;
         exit(-1);
     }
-    // check the completion status (here we don't care about the completion
-    // opcode)
-    if(wc.status != IBV_WC_SUCCESS) {
-        cout << "got bad completion with status: "
-             << wc.status << ", vendor syndrome: " << wc.vendor_err;
-        return {wc.wr_id, {wc.qp_num, -1}};
+    for(int i = 0; i < poll_result; ++i) {
+        const struct ibv_wc &wc = wcs[i];
+        // check the completion status (here we don't care about the completion
+        // opcode)
+        if(wc.status != IBV_WC_SUCCESS) {
+            cout << "got bad completion with status: "
+                 << wc.status << ", vendor syndrome: " << wc.vendor_err;
+            entries[i] = {wc.wr_id, {wc.qp_num, -1}};
+        } else {
+            entries[i] = {wc.wr_id, {wc.qp_num, 1}};
+        }
     }
-    return {wc.wr_id, {wc.qp_num, 1}};
+    return poll_result;
 }
 
 /** Allocates memory for global RDMA resources. */
@@ -559,6 +584,7 @@ void verbs_initialize(const std::map<uint32_t, std::string> &ip_addrs, uint32_t
     resources_init();
     // create resources before using them
     resources_create();
+    set_transport_type(TransportType::RDMA);
 
     cout << "Initialized global RDMA resources" << endl;
 }
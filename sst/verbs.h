@@ -11,6 +11,8 @@
 
 #include <infiniband/verbs.h>
 
+#include "transport.h"
+
 namespace sst {
 
 /** Structure to exchange the data needed to connect the Queue Pairs */
@@ -31,7 +33,7 @@ struct cm_con_data_t {
  * Represents the set of RDMA resources needed to maintain a two-way connection
  * to a single remote node.
  */
-class resources {
+class resources : public row_transport {
 private:
     /** Initializes the queue pair. */
     void set_qp_initialized();
@@ -78,10 +80,12 @@ public:
     /** Post an RDMA write at the beginning address of remote memory. */
     void post_remote_write(const uint32_t id, const long long int size);
     /** Post an RDMA write at an offset into remote memory. */
-    void post_remote_write(const uint32_t id, const long long int offset, long long int size);
+    void post_remote_write(const uint32_t id, const long long int offset, const long long int size);
     void post_remote_write_with_completion(const uint32_t id, const long long int size);
     /** Post an RDMA write at an offset into remote memory. */
     void post_remote_write_with_completion(const uint32_t id, const long long int offset, const long long int size);
+    /** Returns the number of the queue pair, which completions are tagged with. */
+    uint32_t get_completion_key() const;
 };
 
 bool add_node(uint32_t new_id, const std::string new_ip_addr);
@@ -89,8 +93,13 @@ bool sync(uint32_t r_index);
 /** Initializes the global verbs resources. */
 void verbs_initialize(const std::map<uint32_t, std::string> &ip_addrs,
                       uint32_t node_rank);
+/** The most completion queue entries taken by a single poll. */
+const int completion_batch_size = 16;
 /** Polls for completion of a single posted remote write. */
 std::pair<uint32_t, std::pair<int, int>> verbs_poll_completion();
+/** Polls for completion of up to max_entries posted remote writes, without
+ * waiting; returns the number of entries found. */
+int verbs_poll_completions(std::pair<uint32_t, std::pair<int, int>>* entries, int max_entries);
 void shutdown_polling_thread();
 /** Destroys the global verbs resources. */
 void verbs_destroy();